@@ -9,6 +9,9 @@ then
 	echo "http://www.progettoemma.net/mess/sysset.php/"
 	echo ""
 	echo "e.g. \"$0 a1200xl\" for the Atari 1200XL plus ~12 related models"
+	echo ""
+	echo "\"$0 a1200xl -s\" afterwards adds a single-machine build of just the"
+	echo "1200XL, built with \"make SYSTEM=a1200xl SINGLE=1\""
 	exit 1
 fi
 
@@ -42,6 +45,45 @@ fi
 
 DRIVER=$1
 
+## Single-machine mode: a subtarget with only this driver (and the parent it
+## takes ROMs from) in its driver list, on top of the family makefile. The
+## siblings' machine configurations and the devices only they use are then
+## unreferenced, and emcc drops them when it links.
+if [ "$2" == "-s" ]
+   then
+   SOURCEFILE=`$MESS64PATH/$MESS64NAME -listxml $DRIVER | grep "\"$DRIVER\".*sourcefile" | sed "s/.*sourcefile=\"\(.*\)\.c.*/\1/"`
+   if [ ! -f $MESSMAKE/$SOURCEFILE.mak ] || [ ! -f $MESSMAKE/$SOURCEFILE.lst ]
+      then
+      echo ""
+      echo "Run \"$0 $DRIVER\" first to create the $SOURCEFILE family makefiles."
+      echo ""
+      exit 1
+   fi
+   PARENTS=`$MESS64PATH/$MESS64NAME -listxml $DRIVER | grep "<machine name=\"$DRIVER\"" | grep -o '\(cloneof\|romof\)="[^"]*"' | cut -f2 -d'"' | sort -u`
+
+   O=${MESSMAKE}/${SOURCEFILE}_${DRIVER}.mak
+   echo "## " >$O
+   echo "## ${SOURCEFILE}_${DRIVER}.mak" >>$O
+   echo "## Single-machine build of $DRIVER, see ${SOURCEFILE}_${DRIVER}.lst" >>$O
+   echo "## " >>$O
+   echo "" >>$O
+   echo "include \$(SRC)/mess/$SOURCEFILE.mak" >>$O
+
+   O=${MESSMAKE}/${SOURCEFILE}_${DRIVER}.lst
+   echo "// " >$O
+   echo "// Drivers in the single-machine build of $DRIVER" >>$O
+   echo "// " >>$O
+   echo "" >> $O
+   for AAA in $DRIVER $PARENTS
+      do
+      grep "^$AAA " $MESSMAKE/$SOURCEFILE.lst >> $O
+   done
+
+   echo "Created ${SOURCEFILE}_${DRIVER}.mak and .lst with: `echo $DRIVER $PARENTS`"
+   echo "Build it with \"make SYSTEM=$DRIVER SINGLE=1\", compare with \"make SYSTEM=$DRIVER compare-single\""
+   exit 0
+fi
+
 if [ "$2" == "-d" ]
    then
    rm -f $JSMESSMAKE/$DRIVER.mak
@@ -0,0 +1,206 @@
+// Read-only filesystem backed by Blobs (dropped or selected Files), mounted
+// at /local. Nothing is copied up front: reads fetch the chunks they touch
+// from the Blob (synchronously, as MAME expects) and keep the most recent
+// ones in a small cache. MAME sees the files like any other; writable media
+// find them read-only and fall back to that.
+//
+// Passed to emcc as a --pre-js so it can be used from preRun, before the
+// engine's main() and before post.js has run.
+
+var JSMESS = JSMESS || {};
+
+var BLOBFS = {
+	DIR_MODE: 16749,   // dr-xr-xr-x
+	FILE_MODE: 33060,  // -r--r--r--
+	CHUNK_SIZE: 256 * 1024,
+	CACHE_CHUNKS: 32,
+	cache: [],         // [{ blob, index, data }], most recent last
+	stats: { reads: 0, bytes: 0, chunk_loads: 0, chunk_hits: 0 },
+
+	mount: function(mount) {
+		var root = BLOBFS.createNode(null, '/', BLOBFS.DIR_MODE, 0);
+		Array.prototype.forEach.call(mount.opts.files || [], function(file) {
+			BLOBFS.createNode(root, file.name, BLOBFS.FILE_MODE, 0, file);
+		});
+		return root;
+	},
+	createNode: function(parent, name, mode, dev, blob) {
+		var node = FS.createNode(parent, name, mode);
+		node.mode = mode;
+		node.node_ops = BLOBFS.node_ops;
+		node.stream_ops = BLOBFS.stream_ops;
+		node.timestamp = blob && blob.lastModified ? blob.lastModified : Date.now();
+		if (blob) {
+			node.size = blob.size;
+			node.contents = blob;
+		} else {
+			node.size = 4096;
+			node.contents = {};
+		}
+		if (parent) {
+			parent.contents[name] = node;
+		}
+		return node;
+	},
+
+	// Reads a whole chunk of a Blob as bytes. Workers have FileReaderSync; the
+	// main thread only has synchronous XHR, on a URL for just that slice.
+	readChunk: function(blob, index) {
+		var slice = blob.slice(index * BLOBFS.CHUNK_SIZE, (index + 1) * BLOBFS.CHUNK_SIZE);
+		if (typeof FileReaderSync !== 'undefined') {
+			return new Uint8Array(new FileReaderSync().readAsArrayBuffer(slice));
+		}
+		var url = URL.createObjectURL(slice);
+		try {
+			var xhr = new XMLHttpRequest();
+			xhr.open('GET', url, false);
+			xhr.overrideMimeType('text/plain; charset=x-user-defined');
+			xhr.send(null);
+			var text = xhr.responseText;
+			var data = new Uint8Array(text.length);
+			for (var i = 0; i < text.length; i++) {
+				data[i] = text.charCodeAt(i) & 0xff;
+			}
+			return data;
+		} finally {
+			URL.revokeObjectURL(url);
+		}
+	},
+	chunk: function(blob, index) {
+		var cache = BLOBFS.cache;
+		for (var i = cache.length - 1; i >= 0; i--) {
+			if (cache[i].blob === blob && cache[i].index === index) {
+				var hit = cache.splice(i, 1)[0];
+				cache.push(hit);
+				BLOBFS.stats.chunk_hits++;
+				return hit.data;
+			}
+		}
+		var data = BLOBFS.readChunk(blob, index);
+		BLOBFS.stats.chunk_loads++;
+		cache.push({ blob: blob, index: index, data: data });
+		if (cache.length > BLOBFS.CACHE_CHUNKS) {
+			cache.shift();
+		}
+		return data;
+	},
+
+	node_ops: {
+		getattr: function(node) {
+			return {
+				dev: 1,
+				ino: undefined,
+				mode: node.mode,
+				nlink: 1,
+				uid: 0,
+				gid: 0,
+				rdev: undefined,
+				size: node.size,
+				atime: new Date(node.timestamp),
+				mtime: new Date(node.timestamp),
+				ctime: new Date(node.timestamp),
+				blksize: 4096,
+				blocks: Math.ceil(node.size / 4096)
+			};
+		},
+		setattr: function(node, attr) {
+			throw new FS.ErrnoError(ERRNO_CODES.EROFS);
+		},
+		lookup: function(parent, name) {
+			throw new FS.ErrnoError(ERRNO_CODES.ENOENT);
+		},
+		mknod: function(parent, name, mode, dev) {
+			throw new FS.ErrnoError(ERRNO_CODES.EROFS);
+		},
+		rename: function(oldNode, newDir, newName) {
+			throw new FS.ErrnoError(ERRNO_CODES.EROFS);
+		},
+		unlink: function(parent, name) {
+			throw new FS.ErrnoError(ERRNO_CODES.EROFS);
+		},
+		rmdir: function(parent, name) {
+			throw new FS.ErrnoError(ERRNO_CODES.EROFS);
+		},
+		readdir: function(node) {
+			var entries = ['.', '..'];
+			for (var name in node.contents) {
+				if (node.contents.hasOwnProperty(name)) {
+					entries.push(name);
+				}
+			}
+			return entries;
+		},
+		symlink: function(parent, newName, oldPath) {
+			throw new FS.ErrnoError(ERRNO_CODES.EROFS);
+		},
+		readlink: function(node) {
+			throw new FS.ErrnoError(ERRNO_CODES.EINVAL);
+		}
+	},
+	stream_ops: {
+		open: function(stream) {
+			// O_WRONLY or O_RDWR: refuse, so MAME opens the image read-only.
+			if (stream.flags & 3) {
+				throw new FS.ErrnoError(ERRNO_CODES.EROFS);
+			}
+		},
+		read: function(stream, buffer, offset, length, position) {
+			var blob = stream.node.contents;
+			var end = Math.min(position + length, stream.node.size);
+			var done = 0;
+			while (position + done < end) {
+				var at = position + done;
+				var index = Math.floor(at / BLOBFS.CHUNK_SIZE);
+				var data = BLOBFS.chunk(blob, index);
+				var from = at - index * BLOBFS.CHUNK_SIZE;
+				var count = Math.min(data.length - from, end - at);
+				buffer.set(data.subarray(from, from + count), offset + done);
+				done += count;
+			}
+			BLOBFS.stats.reads++;
+			BLOBFS.stats.bytes += done;
+			return done;
+		},
+		write: function(stream, buffer, offset, length, position) {
+			throw new FS.ErrnoError(ERRNO_CODES.EROFS);
+		},
+		llseek: function(stream, offset, whence) {
+			var position = offset;
+			if (whence === 1) {         // SEEK_CUR
+				position += stream.position;
+			} else if (whence === 2) {  // SEEK_END
+				position += stream.node.size;
+			}
+			if (position < 0) {
+				throw new FS.ErrnoError(ERRNO_CODES.EINVAL);
+			}
+			return position;
+		}
+	}
+};
+
+// Mounts Files (from a file input or a drop) at /local, replacing whatever
+// was mounted there before.
+JSMESS.mount_local = function(files) {
+	try {
+		FS.unmount('/local');
+	} catch (e) {
+	}
+	try {
+		FS.mkdir('/local');
+	} catch (e) {
+	}
+	BLOBFS.cache = [];
+	FS.mount(BLOBFS, { files: files }, '/local');
+	return Array.prototype.map.call(files, function(file) { return '/local/' + file.name; });
+};
+JSMESS.local_stats = function() {
+	// Quoted, so CLOSURE=1 builds keep the names.
+	return {
+		'reads': BLOBFS.stats.reads,
+		'bytes': BLOBFS.stats.bytes,
+		'chunk_loads': BLOBFS.stats.chunk_loads,
+		'chunk_hits': BLOBFS.stats.chunk_hits,
+		'bytes_loaded': BLOBFS.stats.chunk_loads * BLOBFS.CHUNK_SIZE
+	};
+};
@@ -0,0 +1,57 @@
+// Closure compiler externs for CLOSURE=1 builds.
+//
+// Names the compiled engine shares with the page: the JSMESS API that pre.js
+// and post.js define and the template scripts call, the flags the engine sets
+// on it, and the web audio entry points the engine calls. Anything not listed
+// here is renamed in the engine. Not copied to the build directory.
+
+/** @type {Object} */
+var JSMESS;
+
+// set by the MAME emscripten OSD
+JSMESS.running;
+
+// pre.js
+JSMESS.ready;
+JSMESS.JSMESS_VERSION;
+JSMESS.MESS_BUILD_VERSION;
+JSMESS.EMCC_VERSION;
+JSMESS.EMCC_FLAGS;
+JSMESS.MESS_FLAGS;
+
+// blobfs.js
+JSMESS.mount_local;
+JSMESS.local_stats;
+
+// post.js
+JSMESS.get_machine;
+JSMESS.get_ui;
+JSMESS.get_sound;
+JSMESS.ui_set_show_fps;
+JSMESS.ui_get_show_fps;
+JSMESS.sound_manager_mute;
+JSMESS.sdl_pauseaudio;
+JSMESS.output_get_value;
+JSMESS.machine_save;
+JSMESS.machine_load;
+JSMESS.machine_nvram_save;
+JSMESS.save_state;
+JSMESS.load_state;
+JSMESS.nvram_save;
+JSMESS.read_file;
+JSMESS.write_file;
+JSMESS.file_size;
+JSMESS.read_range;
+JSMESS.write_range;
+JSMESS.truncate;
+JSMESS.remove_file;
+JSMESS.mkdir;
+JSMESS.on_file_write;
+JSMESS.demangle;
+JSMESS.run_frame;
+
+// webaudio.js
+/** @type {function(...*)} */
+var jsmess_set_mastervolume;
+/** @type {function(...*)} */
+var jsmess_update_audio_stream;
@@ -0,0 +1,198 @@
+// jsmess fast loading
+//
+// Cassette and floppy software can take minutes of emulated time to load.
+// While fast loading is on, every animation frame runs as many extra
+// emulated frames as fit in a time budget, with sound off. It ends when the
+// user clicks (or, without a probe, presses a key), or after max_seconds of
+// fast emulated time.
+//
+// With a probe, fast loading waits at normal speed (sound on, keys going to
+// the emulated machine, e.g. to type LOAD) until the drive or motor starts,
+// and goes back to waiting whenever it stops: tapes with several blocks stop
+// the motor between them. It is armed at boot when a cassette or floppy is
+// mounted from the command line and the system has a known drive or motor
+// output (see outputs below, or ?fastload=<output> in the URL). Any system
+// can start it by hand:
+//
+//   JSMESS.fastload.start({ probe: JSMESS.fastload.output_probe('led0') });
+//   JSMESS.fastload.stats();
+//
+// The emulated drive keeps its real timing; only the host runs it faster.
+// Shortening disk or tape timing would have to be done in MAME's device
+// emulation, out of reach of the page.
+
+var JSMESS = JSMESS || {};
+
+JSMESS.fastload = (function () {
+
+var defaults = {
+	budget_ms: 12,
+	max_seconds: 300,
+	stop_on_input: true,
+	// returns true while the drive or cassette motor is busy
+	probe: null
+};
+
+// System -> MAME output that is non-zero while its drive or cassette motor
+// runs, as the driver sets it (`-output console` lists them natively).
+var outputs = {
+	// cassette motor LED, set with the motor relay
+	bbca: 'motor_led',
+	bbcb: 'motor_led',
+	bbcbp: 'motor_led',
+	// 1541 drive activity LED (led0 is its power LED)
+	c64: 'led1',
+	c64p: 'led1'
+};
+
+var FRAME_SECONDS = 1 / 60;  // one main loop iteration
+
+var config = null;
+var active = false;
+var fast = false;            // running extra frames (else waiting for the drive)
+var frames = 0;              // fast frames, over all bursts
+var fast_ms = 0;             // wall time of finished bursts
+var started_at = 0;          // start of the current burst
+var bursts = 0;
+var audio = null;
+var last = null;
+
+function now () {
+	return window.performance ? performance.now() : Date.now();
+};
+
+function on_input (e) {
+	if (e.jsmess_netplay) return;
+	// With a probe the drive decides; keys are for the emulated machine.
+	if (e.type === 'keydown' && config.probe) return;
+	finish('input');
+};
+
+function busy () {
+	return !config.probe || !!config.probe();
+};
+
+function go_fast () {
+	fast = true;
+	bursts++;
+	started_at = now();
+	audio = window.jsmess_update_audio_stream;
+	window.jsmess_update_audio_stream = function () {};
+};
+
+// Back to normal speed until the probe reports the drive busy again.
+function go_slow () {
+	fast = false;
+	fast_ms += now() - started_at;
+	window.jsmess_update_audio_stream = audio;
+};
+
+function fast_seconds () {
+	return (fast_ms + (fast ? now() - started_at : 0)) / 1000;
+};
+
+function post_frame () {
+	if (!fast) {
+		if (!busy()) return;
+		go_fast();
+	}
+	frames++;
+	if (frames * FRAME_SECONDS >= config.max_seconds) {
+		finish('max_seconds');
+		return;
+	}
+	var start = now();
+	while (now() - start < config.budget_ms) {
+		if (!busy()) {
+			go_slow();
+			return;
+		}
+		JSMESS.run_frame();
+		frames++;
+	}
+};
+
+function start (options) {
+	if (active) return;
+	config = {};
+	for (var k in defaults) config[k] = defaults[k];
+	for (var k in options) config[k] = options[k];
+
+	active = true;
+	fast = false;
+	frames = 0;
+	fast_ms = 0;
+	bursts = 0;
+	if (!config.probe) go_fast();
+	if (config.stop_on_input) {
+		window.addEventListener('keydown', on_input, true);
+		window.addEventListener('mousedown', on_input, true);
+	}
+	JSMESS.post_frame_hooks.push(post_frame);
+};
+
+function finish (reason) {
+	if (!active) return;
+	active = false;
+	JSMESS.remove_post_frame_hook(post_frame);
+	window.removeEventListener('keydown', on_input, true);
+	window.removeEventListener('mousedown', on_input, true);
+	if (fast) go_slow();
+
+	last = summary();
+	last.reason = reason;
+	console.log('JSMESS fast load finished (' + reason + '): ' +
+		last.emulated_seconds.toFixed(1) + 's emulated in ' + last.wall_seconds.toFixed(1) + 's, ' +
+		last.saved_seconds.toFixed(1) + 's saved');
+};
+
+// Probe for a MAME output (drive LEDs and the like); true while non-zero.
+function output_probe (name) {
+	return function () {
+		return JSMESS.output_get_value(name) !== 0;
+	};
+};
+
+// Times cover the fast bursts only, not the waits between them.
+function summary () {
+	var wall = fast_seconds();
+	var emulated = frames * FRAME_SECONDS;
+	return {
+		reason: null,
+		bursts: bursts,
+		emulated_seconds: emulated,
+		wall_seconds: wall,
+		saved_seconds: Math.max(0, emulated - wall),
+		speedup: wall > 0 ? emulated / wall : 0
+	};
+};
+
+function get_stats () {
+	return active ? summary() : last;
+};
+
+// Mounting a cassette or floppy on the command line arms it at boot, if the
+// system's drive activity can be watched.
+JSMESS.ready(function () {
+	var args = Module['arguments'] || [];
+	var output = (/[?&]fastload=([^&]*)/.exec(window.location.search) || [])[1] || outputs[args[0]];
+	if (!output) return;
+	for (var i = 0; i < args.length; i++) {
+		if (/^-(cass|cassette|flop|floppydisk)\d*$/.test(args[i])) {
+			start({ probe: output_probe(decodeURIComponent(output)) });
+			return;
+		}
+	}
+});
+
+return {
+	start: start,
+	stop: function () { finish('stop'); },
+	stats: get_stats,
+	output_probe: output_probe,
+	outputs: outputs,
+	// true while extra frames are running (not while waiting for the drive)
+	is_active: function () { return active && fast; }
+};
+
+})();
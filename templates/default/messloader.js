@@ -35,6 +35,152 @@ JSMESS.fullScreenChangeHandler = function() {
 	}
 }
 
+// Startup timing. Marks are milliseconds since navigation start. Every boot is
+// kept in localStorage, cold (engine came over the network) or warm (engine
+// came from the cache), so percentiles build up across reloads.
+JSMESS.startup = {
+	marks: {},
+	history_key: 'jsmess-startup-MESS_SRC',
+	history_length: 50,
+	mark: function(name) {
+		if (!(name in JSMESS.startup.marks)) {
+			JSMESS.startup.marks[name] = window.performance ? performance.now() : Date.now();
+		}
+	},
+	phases: function() {
+		var m = JSMESS.startup.marks;
+		return {
+			ttfb: m.ttfb,
+			assets: m.assets - m.loader,
+			engine: m.engine - m.assets,
+			// from the last byte of the engine (or the request for it, if it
+			// was already there) to the end of its top-level code
+			parse: m.engine - Math.max(m.downloaded || 0, m.assets),
+			start: m.preinit - m.engine,
+			firstframe: m.firstframe - m.preinit,
+			total: m.firstframe
+		};
+	},
+	history: function() {
+		try {
+			return JSON.parse(localStorage.getItem(JSMESS.startup.history_key)) || [];
+		} catch (e) {
+			return [];
+		}
+	},
+	record: function() {
+		var mode = 'cold';
+		if (window.performance && performance.getEntriesByName) {
+			var entry = performance.getEntriesByName(JSMESS.startup.engine_url)[0];
+			if (entry && entry.transferSize === 0) {
+				mode = 'warm';
+			}
+			// First byte of the engine, whether it was requested by the
+			// loader or by a preload hint.
+			if (entry && entry.responseStart) {
+				JSMESS.startup.marks.ttfb = entry.responseStart;
+			}
+			if (entry && entry.responseEnd) {
+				JSMESS.startup.marks.downloaded = entry.responseEnd;
+			}
+		}
+		var history = JSMESS.startup.history();
+		history.push({ mode: mode, phases: JSMESS.startup.phases() });
+		history = history.slice(-JSMESS.startup.history_length);
+		try {
+			localStorage.setItem(JSMESS.startup.history_key, JSON.stringify(history));
+		} catch (e) {
+		}
+		console.log('JSMESS startup (' + mode + '): ' + JSON.stringify(JSMESS.startup.phases()));
+	},
+	// Returns mamebench log lines (tab separated, milliseconds) with p50, p90
+	// and max of every phase across the stored boots.
+	report: function() {
+		var history = JSMESS.startup.history();
+		var game = JSMESS.bench_name();
+		var lines = [];
+		['cold', 'warm'].forEach(function(mode) {
+			var runs = history.filter(function(h) { return h.mode === mode; });
+			if (runs.length === 0) {
+				return;
+			}
+			for (var phase in runs[0].phases) {
+				var v = runs.map(function(h) { return h.phases[phase]; }).sort(function(a, b) { return a - b; });
+				var pct = function(p) { return v[Math.max(0, Math.ceil(p * v.length) - 1)]; };
+				var metric = 'startup.js.' + mode + '.' + phase;
+				lines.push([game, '', Math.round(pct(0.5)), metric + '.p50'].join('\t'));
+				lines.push([game, '', Math.round(pct(0.9)), metric + '.p90'].join('\t'));
+				lines.push([game, '', Math.round(v[v.length - 1]), metric + '.max'].join('\t'));
+			}
+		});
+		return lines.join('\n');
+	}
+};
+JSMESS.startup.mark('loader');
+
+// Functions run after every main loop iteration (one emulated 1/60s).
+JSMESS.post_frame_hooks = [];
+JSMESS.remove_post_frame_hook = function(hook) {
+	var i = JSMESS.post_frame_hooks.indexOf(hook);
+	if (i >= 0) {
+		JSMESS.post_frame_hooks.splice(i, 1);
+	}
+};
+// Name of what is running, as mamebench logs it.
+JSMESS.bench_name = function() {
+	return Module['arguments'][0] + (gamename !== '' ? ':' + gamename : '');
+};
+
+// Runs the emulator flat out for about `seconds` of wall time, in slices that
+// keep the page responsive, with the normal main loop and sound off. Logs
+// (and passes to callback) mamebench lines with the speed in percent of real
+// time, metric "speed.js", and the time spent presenting frames in ms per
+// emulated second, "cost.present.js". With `emulated` set, runs exactly
+// `seconds` of emulated time instead, as MAME's -bench does.
+JSMESS.benchmark = function(seconds, callback, emulated) {
+	var now = function() { return window.performance ? performance.now() : Date.now(); };
+	var limit = (seconds || 30) * 1000;
+	var frames = 0;
+	var elapsed = 0;
+	var present_ms = JSMESS.present.ms;
+	var pre_main_loop = Module['preMainLoop'];
+	var audio = window.jsmess_update_audio_stream;
+	Module['preMainLoop'] = function() { return false; };
+	window.jsmess_update_audio_stream = function() {};
+	var slice = function() {
+		var start = now();
+		while (now() - start < 100 && !(emulated && frames >= seconds * 60)) {
+			JSMESS.run_frame();
+			frames++;
+		}
+		elapsed += now() - start;
+		if (emulated ? frames < seconds * 60 : elapsed < limit) {
+			setTimeout(slice, 0);
+			return;
+		}
+		Module['preMainLoop'] = pre_main_loop;
+		window.jsmess_update_audio_stream = audio;
+		var speed = (frames / 60) / (elapsed / 1000) * 100;
+		var present = (JSMESS.present.ms - present_ms) / (frames / 60);
+		var lines = [
+			[JSMESS.bench_name(), '', speed.toFixed(2) + '%', 'speed.js', ''].join('\t'),
+			[JSMESS.bench_name(), '', present.toFixed(2), 'cost.present.js', ''].join('\t')
+		].join('\n');
+		console.log(lines);
+		if (callback) {
+			callback(lines);
+		}
+	};
+	JSMESS.ready(slice);
+};
+
+JSMESS.post_frame_hooks.push(function first_frame() {
+	// Only the first frame is interesting.
+	JSMESS.remove_post_frame_hook(first_frame);
+	JSMESS.startup.mark('firstframe');
+	JSMESS.startup.record();
+});
+
 
 var gamename = 'GAME_FILE';
 var game_file = null;
@@ -56,6 +202,90 @@ newCanvas.height = 256;
 var holder = document.getElementById('canvasholder');
 holder.appendChild(newCanvas);
 
+// Frame presentation. Frames reach the canvas through putImageData; the time
+// spent there is tracked per megapixel. The 2D context is created here, before
+// SDL asks for it, as an opaque context: the emulator never produces
+// transparency, and an opaque canvas is never blended with the page.
+JSMESS.present = {
+	frames: 0,
+	pixels: 0,
+	ms: 0,
+	// called with every ImageData put on the canvas (see recorder.js)
+	hooks: [],
+	reset: function() {
+		JSMESS.present.frames = JSMESS.present.pixels = JSMESS.present.ms = 0;
+	},
+	stats: function() {
+		var p = JSMESS.present;
+		return {
+			frames: p.frames,
+			megapixels: p.pixels / 1e6,
+			ms_per_frame: p.frames ? p.ms / p.frames : 0,
+			ms_per_megapixel: p.pixels ? p.ms / (p.pixels / 1e6) : 0
+		};
+	},
+	// Synthetic present cost at a given size: "copy" is the heap to ImageData
+	// copy with the alpha fill the SDL port does every frame, "put" is
+	// putImageData itself. Both in milliseconds per megapixel.
+	benchmark: function(width, height, iterations) {
+		width = width || 640;
+		height = height || 480;
+		iterations = iterations || 200;
+		var canvas = document.createElement('canvas');
+		canvas.width = width;
+		canvas.height = height;
+		var ctx = canvas.getContext('2d', { alpha: false });
+		var image = ctx.createImageData(width, height);
+		var num = width * height;
+		var source = new Int32Array(num);
+		for (var i = 0; i < num; i++) {
+			source[i] = (i * 2654435761) | 0;
+		}
+		var data32 = new Int32Array(image.data.buffer);
+		var data8 = new Uint8Array(image.data.buffer);
+		var megapixels = num * iterations / 1e6;
+
+		var start = performance.now();
+		for (var n = 0; n < iterations; n++) {
+			data32.set(source);
+			for (var a = 3, end = 4 * num; a < end; a += 4) {
+				data8[a] = 0xff;
+			}
+		}
+		var copy = performance.now() - start;
+
+		start = performance.now();
+		for (var n = 0; n < iterations; n++) {
+			ctx.putImageData(image, 0, 0);
+		}
+		ctx.getImageData(0, 0, 1, 1); // wait for the last put to land
+		var put = performance.now() - start;
+
+		return {
+			copy_ms_per_megapixel: copy / megapixels,
+			put_ms_per_megapixel: put / megapixels
+		};
+	}
+};
+(function() {
+	var ctx = newCanvas.getContext('2d', { alpha: false });
+	if (!ctx || !window.performance) {
+		return;
+	}
+	var put = ctx.putImageData;
+	ctx.putImageData = function(image) {
+		var start = performance.now();
+		put.apply(ctx, arguments);
+		JSMESS.present.ms += performance.now() - start;
+		JSMESS.present.frames++;
+		JSMESS.present.pixels += image.width * image.height;
+		var hooks = JSMESS.present.hooks;
+		for (var i = 0; i < hooks.length; i++) {
+			hooks[i](image);
+		}
+	};
+})();
+
 var fullscreenbutton = document.getElementById('gofullscreen');
 if (fullscreenbutton) {
 	fullscreenbutton.addEventListener('click', gofullscreen);
@@ -91,7 +321,14 @@ var Module = {
 	SDL_numSimultaneouslyQueuedBuffers: 5,
 	noInitialRun: false,
 	screenIsReadOnly: true,
+	postMainLoop: function() {
+		var hooks = JSMESS.post_frame_hooks.slice();
+		for (var i = 0; i < hooks.length; i++) {
+			hooks[i]();
+		}
+	},
 	preInit: function() {
+		JSMESS.startup.mark('preinit');
 		// Load the downloaded binary files into the filesystem.
 		for (var bios_fname in bios_files) {
 			if (bios_files.hasOwnProperty(bios_fname)) {
@@ -101,18 +338,28 @@ var Module = {
 		if (gamename !== "") {
 			Module['FS_createDataFile']('/', gamename, game_file, true, true);
 		}
-		if (Modernizr.webaudio && !(Modernizr.mozsetup)) {
-			var asample;
-			try {
-				asample = new AudioContext();
-			} catch (e) {
-				asample = new webkitAudioContext();
+		// Run the mixer at the rate of the shared audio context, or at the
+		// rate the web audio backend resamples from.
+		if (typeof(new Audio()['mozSetup']) !== 'function') {
+			var rate = jsmess_web_audio.get_emulator_rate();
+			if (rate) {
+				Module.arguments.push("-samplerate", rate.toString());
 			}
-			Module.arguments.push("-samplerate", asample.sampleRate.toString());
 		}
 	}
 };
 
+// Static data of the engine, in its own binary file. It downloads alongside
+// the BIOS and game files, and emscripten copies it into the heap in one go
+// once the engine runs.
+var mem_file = 'MESS_MEM';
+if (mem_file !== '') {
+	Module.memoryInitializerRequest = new XMLHttpRequest();
+	Module.memoryInitializerRequest.open('GET', mem_file, true);
+	Module.memoryInitializerRequest.responseType = 'arraybuffer';
+	Module.memoryInitializerRequest.send(null);
+}
+
 var update_countdown = function() {
   file_countdown -= 1;
   if (file_countdown === 0) {
@@ -120,10 +367,54 @@ var update_countdown = function() {
 		var newScript = document.createElement('script');
 		newScript.type = 'text/javascript';
 		newScript.src = 'MESS_SRC';
+		newScript.onload = function() { JSMESS.startup.mark('engine'); };
+		JSMESS.startup.engine_url = newScript.src;
+		JSMESS.startup.mark('assets');
 		headID.appendChild(newScript);
   }
 };
 
+// Local files. Files dropped on the canvas or picked with the file input are
+// mounted read-only at /local without being read up front (see blobfs.js).
+// With ?local=<media option> in the URL, e.g. ?local=flop1, the emulator
+// waits for a file and starts with it mounted; otherwise files can be
+// mounted at any time and loaded from MAME's file manager.
+var local_option = (/[?&]local=([^&]*)/.exec(window.location.search) || [])[1];
+var local_files = null;
+JSMESS.local_files = function(files) {
+	if (!files || files.length === 0) {
+		return;
+	}
+	if (JSMESS.running) {
+		var paths = JSMESS.mount_local(files);
+		Module.print('Mounted ' + paths.join(', ') + ', load it from the file manager');
+	} else if (local_files === null && local_option) {
+		local_files = files;
+		Module.arguments.push('-' + local_option, '/local/' + files[0].name);
+		update_countdown();
+	}
+};
+if (local_option) {
+	file_countdown++;
+	Module.print('Drop a file on the screen or choose one to start with it as -' + local_option);
+}
+Module.preRun = [function() {
+	if (local_files !== null) {
+		JSMESS.mount_local(local_files);
+	}
+}];
+(function() {
+	var input = document.getElementById('localfiles');
+	if (input) {
+		input.addEventListener('change', function() { JSMESS.local_files(input.files); });
+	}
+	holder.addEventListener('dragover', function(e) { e.preventDefault(); });
+	holder.addEventListener('drop', function(e) {
+		e.preventDefault();
+		JSMESS.local_files(e.dataTransfer.files);
+	});
+})();
+
 function gofullscreen() {
   Module.requestFullScreen(1,0);
 }
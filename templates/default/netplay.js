@@ -0,0 +1,351 @@
+// jsmess rollback netplay
+//
+// Every frame both sides send their input and run ahead with a prediction
+// of the other side's input (the last input received). The state before each
+// frame is kept in MEMFS; when a remote input arrives that differs from the
+// prediction, the game is rolled back to that frame and re-simulated up to the
+// present with the real input. A side that gets more than max_rollback frames
+// ahead of the other waits for it.
+//
+// The loopback relay connects two pages on the same machine (two tabs or
+// windows) over a BroadcastChannel, with optional artificial latency:
+//
+//   JSMESS.netplay.start({ room: 'test', player: 0, latency: 60 });   // tab 1
+//   JSMESS.netplay.start({ room: 'test', player: 1, latency: 60 });   // tab 2
+//   JSMESS.netplay.stats();
+//
+// Rollback needs a state saved before every frame. MAME saves nothing for a
+// driver without save state support and postpones the save while anonymous
+// timers are pending, so every save is checked for a fresh file; start()
+// refuses a driver whose probe save fails, and a save that fails later ends
+// the session.
+
+var JSMESS = JSMESS || {};
+
+JSMESS.netplay = (function () {
+
+var defaults = {
+	room: 'default',
+	player: 0,
+	max_rollback: 8,
+	latency: 0,
+	jitter: 0,
+	// keyCodes read from the local keyboard, one bit each
+	local_keys: [38, 40, 37, 39, 17, 18],
+	// keyCodes MAME expects for each player, in the same bit order
+	player_keys: [
+		[38, 40, 37, 39, 17, 18],  // P1: arrows, left ctrl, left alt
+		[82, 70, 68, 71, 65, 83]   // P2: R F D G, A S
+	]
+};
+
+var config = null;
+var relay = null;
+var active = false;
+var started = false;
+var frame = 0;              // next frame to run
+var local_state = 0;        // current local keyboard bitmask
+var inputs = [[], []];      // inputs[player][frame], confirmed
+var predicted = [];         // remote input used for each frame
+var applied = [0, 0];       // bitmasks currently pressed in MAME
+var last_remote = -1;       // newest frame with confirmed remote input
+var remote_ack = -1;        // newest local input the other side has
+var pending_rollback = -1;  // oldest frame with a misprediction
+var saved_premainloop = null;
+var stats = null;
+
+function reset_stats () {
+	stats = {
+		frames: 0,
+		rollbacks: 0,
+		max_depth: 0,
+		total_depth: 0,
+		resimulated: 0,
+		stalls: 0,
+		resim_window: []
+	};
+};
+
+function state_path (f) {
+	return '/netplay/' + (f % (config.max_rollback + 2)) + '.sta';
+};
+
+// Loopback relay: messages to the other page in the same room go over a
+// BroadcastChannel, delivered after latency +- jitter milliseconds.
+function LoopbackRelay (room, latency, jitter) {
+	var self = this;
+	this.channel = new BroadcastChannel('jsmess-netplay-' + room);
+	this.onmessage = null;
+	this.channel.onmessage = function (e) {
+		var delay = latency + (Math.random() * 2 - 1) * jitter;
+		if (delay <= 0) {
+			self.onmessage && self.onmessage(e.data);
+		} else {
+			setTimeout(function () { self.onmessage && self.onmessage(e.data); }, delay);
+		}
+	};
+};
+LoopbackRelay.prototype.send = function (msg) {
+	this.channel.postMessage(msg);
+};
+LoopbackRelay.prototype.close = function () {
+	this.channel.close();
+};
+
+function key_index (keyCode) {
+	return config.local_keys.indexOf(keyCode);
+};
+
+// Local keys are captured before SDL sees them; only the rollback loop
+// presses keys in MAME.
+function on_key (e) {
+	if (e.jsmess_netplay) return;
+	var bit = key_index(e.keyCode);
+	if (bit < 0) return;
+	if (e.type === 'keydown')
+		local_state |= (1 << bit);
+	else
+		local_state &= ~(1 << bit);
+	e.stopImmediatePropagation();
+	e.preventDefault();
+};
+
+function send_key (type, keyCode) {
+	var e = document.createEvent('Event');
+	e.initEvent(type, true, true);
+	e.keyCode = e.which = keyCode;
+	e.jsmess_netplay = true;
+	document.dispatchEvent(e);
+};
+
+function apply_input (player, mask) {
+	var changed = mask ^ applied[player];
+	var keys = config.player_keys[player];
+	for (var bit = 0; changed; bit++, changed >>= 1) {
+		if (changed & 1)
+			send_key((mask & (1 << bit)) ? 'keydown' : 'keyup', keys[bit]);
+	}
+	applied[player] = mask;
+};
+
+function remote_player () {
+	return 1 - config.player;
+};
+
+function remote_input (f) {
+	var confirmed = inputs[remote_player()][f];
+	if (confirmed !== undefined) return confirmed;
+	// Predict: the remote side keeps doing what it last did.
+	return last_remote >= 0 ? inputs[remote_player()][last_remote] : 0;
+};
+
+// Saves a state now and tells whether it was written. The old file goes
+// first, so a stale slot can't pass for this save.
+function save (path) {
+	JSMESS.remove_file(path);
+	JSMESS.save_state(path);
+	try {
+		return JSMESS.file_size(path) > 0;
+	} catch (e) {
+		return false;
+	}
+};
+
+function fail (reason) {
+	console.error('netplay: ' + reason);
+	stop();
+};
+
+// Saves the state before frame f and presses the keys for its inputs; the
+// caller runs the frame. False, with the session stopped, if the state could
+// not be saved.
+function simulate (f) {
+	if (!save(state_path(f))) {
+		fail('the state before frame ' + f + ' was not saved (deferred by MAME), stopping');
+		return false;
+	}
+	predicted[f] = remote_input(f);
+	apply_input(config.player, inputs[config.player][f] || 0);
+	apply_input(remote_player(), predicted[f]);
+	return true;
+};
+
+function rollback () {
+	var from = pending_rollback;
+	pending_rollback = -1;
+	var depth = frame - from;
+
+	JSMESS.load_state(state_path(from));
+	// Audio from re-simulated frames has already been played.
+	var audio = window.jsmess_update_audio_stream;
+	window.jsmess_update_audio_stream = function () {};
+	try {
+		for (var f = from; f < frame; f++) {
+			if (!simulate(f)) return false;
+			JSMESS.run_frame();
+		}
+	} finally {
+		window.jsmess_update_audio_stream = audio;
+	}
+
+	var now = Date.now();
+	stats.rollbacks++;
+	stats.total_depth += depth;
+	stats.resimulated += depth;
+	stats.max_depth = Math.max(stats.max_depth, depth);
+	stats.resim_window.push([now, depth]);
+	return true;
+};
+
+function on_message (msg) {
+	if (msg.player === config.player) return;
+	if (msg.type === 'hello' || msg.type === 'state') {
+		if (config.player === 0 && msg.type === 'hello') {
+			// The host decides where the session starts.
+			send_state();
+		} else if (config.player !== 0 && msg.type === 'hello') {
+			// The host came up after us.
+			relay.send({ type: 'hello', player: config.player });
+		} else if (config.player !== 0 && msg.type === 'state') {
+			JSMESS.write_file(state_path(0), new Uint8Array(msg.state));
+			JSMESS.load_state(state_path(0));
+			begin();
+		}
+		return;
+	}
+	if (msg.type !== 'input' || !started) return;
+	var player = remote_player();
+	if (msg.ack > remote_ack) remote_ack = msg.ack;
+	for (var i = 0; i < msg.inputs.length; i++) {
+		var f = msg.first + i;
+		if (inputs[player][f] !== undefined) continue;
+		inputs[player][f] = msg.inputs[i];
+		if (f > last_remote) last_remote = f;
+		if (f < frame && predicted[f] !== msg.inputs[i] &&
+		    (pending_rollback < 0 || f < pending_rollback))
+			pending_rollback = f;
+	}
+};
+
+function send_state () {
+	if (!save(state_path(0))) {
+		fail('the starting state was not saved (deferred by MAME), stopping');
+		return;
+	}
+	relay.send({
+		type: 'state',
+		player: config.player,
+		state: JSMESS.read_file(state_path(0)).buffer
+	});
+	begin();
+};
+
+function begin () {
+	frame = 0;
+	inputs = [[], []];
+	predicted = [];
+	last_remote = -1;
+	remote_ack = -1;
+	pending_rollback = -1;
+	reset_stats();
+	started = true;
+};
+
+function pre_main_loop () {
+	if (!started) return false;
+
+	// Pacing (throttle.js) decides whether this callback runs a frame at all.
+	if (saved_premainloop && saved_premainloop() === false) return false;
+
+	if (pending_rollback >= 0 && !rollback())
+		return false;
+
+	// Too far ahead of the other side: wait for it.
+	if (frame - last_remote > config.max_rollback) {
+		stats.stalls++;
+		return false;
+	}
+
+	inputs[config.player][frame] = local_state;
+	// Everything the other side has not acknowledged yet goes out again, so
+	// a lost or early message cannot desync the session.
+	relay.send({
+		type: 'input',
+		player: config.player,
+		ack: last_remote,
+		first: remote_ack + 1,
+		inputs: inputs[config.player].slice(remote_ack + 1, frame + 1)
+	});
+
+	if (!simulate(frame)) return false;
+	frame++;
+	stats.frames++;
+	// The normal main loop iteration runs the frame.
+	return true;
+};
+
+function start (options) {
+	if (active) stop();
+	config = {};
+	for (var k in defaults) config[k] = defaults[k];
+	for (var k in options) config[k] = options[k];
+
+	JSMESS.mkdir('/netplay');
+	if (!save('/netplay/probe.sta')) {
+		console.error('netplay: this driver did not save a state; it has no save state support, or MAME deferred the save');
+		return false;
+	}
+	JSMESS.remove_file('/netplay/probe.sta');
+	relay = config.relay || new LoopbackRelay(config.room, config.latency, config.jitter);
+	relay.onmessage = on_message;
+	window.addEventListener('keydown', on_key, true);
+	window.addEventListener('keyup', on_key, true);
+	saved_premainloop = Module['preMainLoop'];
+	Module['preMainLoop'] = pre_main_loop;
+	active = true;
+	started = false;
+	applied = [0, 0];
+	reset_stats();
+	relay.send({ type: 'hello', player: config.player });
+	return true;
+};
+
+function stop () {
+	if (!active) return;
+	Module['preMainLoop'] = saved_premainloop;
+	window.removeEventListener('keydown', on_key, true);
+	window.removeEventListener('keyup', on_key, true);
+	apply_input(0, 0);
+	apply_input(1, 0);
+	relay.close();
+	active = started = false;
+};
+
+function get_stats () {
+	// Nothing to report before the first session.
+	if (!stats) return null;
+	var now = Date.now();
+	stats.resim_window = stats.resim_window.filter(function (r) { return now - r[0] < 1000; });
+	var resim_per_second = 0;
+	for (var i = 0; i < stats.resim_window.length; i++)
+		resim_per_second += stats.resim_window[i][1];
+	return {
+		frames: stats.frames,
+		rollbacks: stats.rollbacks,
+		max_rollback_depth: stats.max_depth,
+		average_rollback_depth: stats.rollbacks ? stats.total_depth / stats.rollbacks : 0,
+		resimulated_frames: stats.resimulated,
+		resimulated_per_second: resim_per_second,
+		stalls: stats.stalls,
+		frames_ahead: frame - 1 - last_remote
+	};
+};
+
+return {
+	start: start,
+	stop: stop,
+	stats: get_stats,
+	LoopbackRelay: LoopbackRelay
+};
+
+})();
@@ -0,0 +1,284 @@
+// jsmess persistence for writable media and NVRAM
+//
+// Writes the emulator makes to floppy and hard disk images, NVRAM and CHD
+// diffs go to MEMFS and would be gone on reload. Every write to a tracked file
+// marks the 4KiB blocks it touched as dirty; dirty blocks are flushed to
+// IndexedDB in one batched transaction, some time after the writes stop and
+// while the browser is idle, so flushing never lands in the frame loop. At
+// boot the stored blocks are laid back over the downloaded images before the
+// emulator starts.
+//
+// Tracked files are everything under the tracked directories plus the images
+// mounted from the command line with a writable media option.
+//
+// MAME writes NVRAM only when the machine exits, which a closed tab never
+// does, so every flush first has MAME save it, and a flush runs every
+// nvram_interval_ms for systems that write nothing else. Floppy images are
+// still written back by MAME only when they are unloaded.
+//
+//   JSMESS.persist.stats();
+//   JSMESS.persist.flush();
+//   JSMESS.persist.clear();   // forget all stored changes
+
+var JSMESS = JSMESS || {};
+
+JSMESS.persist = (function () {
+
+var BLOCK_SIZE = 4096;
+
+var config = {
+	// defaults to one database per system and set of mounted images
+	database: null,
+	directories: ['/nvram/', '/diff/'],
+	media_options: /^-(flop|floppydisk|hard|harddisk|cass|cassette)\d*$/,
+	// flush this long after the last write...
+	debounce_ms: 2000,
+	// ...but never later than this after the first unflushed one
+	max_delay_ms: 10000,
+	nvram_interval_ms: 30000
+};
+
+var db = null;
+var images = {};            // image paths mounted from the command line
+var dirty = {};             // path -> { block index: true }
+var restoring = false;
+var timer = null;
+var first_dirty = 0;
+var flushing = false;
+var saving_nvram = false;
+var stats = {
+	writes: 0,              // emulator writes to tracked files
+	bytes_dirtied: 0,
+	flushes: 0,
+	blocks_written: 0,
+	bytes_written: 0,       // bytes stored in IndexedDB
+	last_flush_ms: 0,
+	restored_blocks: 0
+};
+
+function now () {
+	return window.performance ? performance.now() : Date.now();
+};
+
+function tracked (path) {
+	if (images[path]) return true;
+	for (var i = 0; i < config.directories.length; i++) {
+		if (path.indexOf(config.directories[i]) === 0) return true;
+	}
+	return false;
+};
+
+function find_images () {
+	var args = Module['arguments'] || [];
+	for (var i = 0; i + 1 < args.length; i++) {
+		if (config.media_options.test(args[i])) {
+			var path = args[i + 1];
+			images[path.charAt(0) === '/' ? path : '/' + path] = true;
+		}
+	}
+};
+
+function mark (path, position, length) {
+	if (length <= 0) return;
+	var blocks = dirty[path] || (dirty[path] = {});
+	var last = Math.floor((position + length - 1) / BLOCK_SIZE);
+	for (var b = Math.floor(position / BLOCK_SIZE); b <= last; b++) {
+		blocks[b] = true;
+	}
+	stats.writes++;
+	stats.bytes_dirtied += length;
+	// The flush that saved NVRAM takes these blocks along.
+	if (!saving_nvram) schedule();
+};
+
+// Debounced: every write pushes the flush back, up to max_delay_ms after
+// the first unflushed write.
+function schedule () {
+	var t = now();
+	if (timer === null) {
+		first_dirty = t;
+	} else {
+		clearTimeout(timer);
+	}
+	var delay = Math.min(config.debounce_ms, Math.max(0, first_dirty + config.max_delay_ms - t));
+	timer = setTimeout(function () {
+		timer = null;
+		if (window.requestIdleCallback) {
+			requestIdleCallback(function () { flush(); }, { timeout: 1000 });
+		} else {
+			flush();
+		}
+	}, delay);
+};
+
+function hook_writes () {
+	JSMESS.on_file_write(function (path, position, length) {
+		if (!restoring && tracked(path)) mark(path, position, length);
+	});
+	setInterval(flush, config.nvram_interval_ms);
+};
+
+// Blocks are stored as { path, block, data } keyed by [path, block]; the
+// current size of every file is stored alongside as block -1.
+function flush () {
+	if (timer !== null) {
+		clearTimeout(timer);
+		timer = null;
+	}
+	if (!db || flushing) return;
+	saving_nvram = true;
+	try {
+		JSMESS.nvram_save();
+	} finally {
+		saving_nvram = false;
+	}
+	var paths = Object.keys(dirty);
+	if (paths.length === 0) return;
+
+	var start = now();
+	var pending = dirty;
+	dirty = {};
+	flushing = true;
+	var tx = db.transaction('blocks', 'readwrite');
+	var store = tx.objectStore('blocks');
+	var bytes = 0;
+	var blocks = 0;
+	paths.forEach(function (path) {
+		var size;
+		try {
+			size = JSMESS.file_size(path);
+		} catch (e) {
+			return;  // deleted since
+		}
+		store.put({ path: path, block: -1, size: size });
+		for (var b in pending[path]) {
+			var from = b * BLOCK_SIZE;
+			if (from >= size) continue;
+			var block = JSMESS.read_range(path, from, Math.min(BLOCK_SIZE, size - from));
+			store.put({ path: path, block: +b, data: block });
+			bytes += block.length;
+			blocks++;
+		}
+	});
+	tx.oncomplete = function () {
+		flushing = false;
+		stats.flushes++;
+		stats.blocks_written += blocks;
+		stats.bytes_written += bytes;
+		stats.last_flush_ms = now() - start;
+		if (Object.keys(dirty).length) schedule();
+	};
+	tx.onerror = tx.onabort = function () {
+		flushing = false;
+		// Try those blocks again with the next flush.
+		for (var path in pending) {
+			var target = dirty[path] || (dirty[path] = {});
+			for (var b in pending[path]) target[b] = true;
+		}
+		schedule();
+	};
+};
+
+// Lays the stored blocks over the files in MEMFS.
+function restore (records) {
+	var files = {};
+	records.forEach(function (r) {
+		var f = files[r.path] || (files[r.path] = { size: 0, blocks: [] });
+		if (r.block < 0) {
+			f.size = r.size;
+		} else {
+			f.blocks.push(r);
+		}
+	});
+	restoring = true;
+	try {
+		for (var path in files) {
+			if (!tracked(path)) continue;
+			JSMESS.mkdir(path.substring(0, path.lastIndexOf('/')));
+			files[path].blocks.forEach(function (r) {
+				JSMESS.write_range(path, r.data, r.block * BLOCK_SIZE);
+				stats.restored_blocks++;
+			});
+			JSMESS.truncate(path, files[path].size);
+		}
+	} finally {
+		restoring = false;
+	}
+};
+
+function open (callback) {
+	var name = config.database ||
+		['jsmess-persist', Module['arguments'][0]].concat(Object.keys(images).sort()).join(':');
+	var request = indexedDB.open(name, 1);
+	request.onupgradeneeded = function () {
+		request.result.createObjectStore('blocks', { keyPath: ['path', 'block'] });
+	};
+	request.onsuccess = function () {
+		callback(request.result);
+	};
+	request.onerror = function () {
+		callback(null);
+	};
+};
+
+// Runs before main: holds the start of the emulator until the stored blocks
+// are back in place.
+function pre_run () {
+	if (!window.indexedDB) return;
+	find_images();
+	Module['addRunDependency']('jsmess-persist');
+	open(function (database) {
+		db = database;
+		if (!db) {
+			Module['removeRunDependency']('jsmess-persist');
+			return;
+		}
+		var request = db.transaction('blocks').objectStore('blocks').getAll();
+		request.onsuccess = function () {
+			restore(request.result);
+			hook_writes();
+			Module['removeRunDependency']('jsmess-persist');
+		};
+		request.onerror = function () {
+			hook_writes();
+			Module['removeRunDependency']('jsmess-persist');
+		};
+	});
+};
+
+function clear () {
+	dirty = {};
+	if (db) db.transaction('blocks', 'readwrite').objectStore('blocks').clear();
+};
+
+function get_stats () {
+	var pending = 0;
+	for (var path in dirty) pending += Object.keys(dirty[path]).length;
+	return {
+		writes: stats.writes,
+		bytes_dirtied: stats.bytes_dirtied,
+		pending_blocks: pending,
+		flushes: stats.flushes,
+		blocks_written: stats.blocks_written,
+		bytes_written: stats.bytes_written,
+		last_flush_ms: stats.last_flush_ms,
+		restored_blocks: stats.restored_blocks
+	};
+};
+
+Module['preRun'] = [].concat(Module['preRun'] || [], pre_run);
+
+// Leaving the page: flush whatever is dirty right away.
+window.addEventListener('pagehide', flush);
+document.addEventListener('visibilitychange', function () {
+	if (document.visibilityState === 'hidden') flush();
+});
+
+return {
+	config: config,
+	flush: flush,
+	clear: clear,
+	stats: get_stats
+};
+
+})();
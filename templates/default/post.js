@@ -4,10 +4,112 @@ function _SDL_GL_LoadLibrary() {}
 
 // MESS-JavaScript function mappings
 var JSMESS = JSMESS || {};
-JSMESS.get_machine = Module.cwrap('_Z14js_get_machinev', 'number');
-JSMESS.get_ui = Module.cwrap('_Z9js_get_uiv', 'number');
-JSMESS.get_sound = Module.cwrap('_Z12js_get_soundv', 'number');
-JSMESS.ui_set_show_fps = Module.cwrap('_ZN10ui_manager12set_show_fpsEb', '', ['number', 'number']);
-JSMESS.ui_get_show_fps = Module.cwrap('_ZNK10ui_manager8show_fpsEv', 'number', ['number']);
-JSMESS.sound_manager_mute = Module.cwrap('_ZN13sound_manager4muteEbh', '', ['number', 'number', 'number']);
-JSMESS.sdl_pauseaudio = Module.cwrap('SDL_PauseAudio', '', ['number']);
+JSMESS.get_machine = Module['cwrap']('_Z14js_get_machinev', 'number');
+JSMESS.get_ui = Module['cwrap']('_Z9js_get_uiv', 'number');
+JSMESS.get_sound = Module['cwrap']('_Z12js_get_soundv', 'number');
+JSMESS.ui_set_show_fps = Module['cwrap']('_ZN10ui_manager12set_show_fpsEb', '', ['number', 'number']);
+JSMESS.ui_get_show_fps = Module['cwrap']('_ZNK10ui_manager8show_fpsEv', 'number', ['number']);
+JSMESS.sound_manager_mute = Module['cwrap']('_ZN13sound_manager4muteEbh', '', ['number', 'number', 'number']);
+JSMESS.sdl_pauseaudio = Module['cwrap']('SDL_PauseAudio', '', ['number']);
+JSMESS.output_get_value = Module['cwrap']('_Z16output_get_valuePKc', 'number', ['string']);
+JSMESS.machine_save = Module['cwrap']('_ZN15running_machine14immediate_saveEPKc', '', ['number', 'string']);
+JSMESS.machine_load = Module['cwrap']('_ZN15running_machine14immediate_loadEPKc', '', ['number', 'string']);
+JSMESS.machine_nvram_save = Module['cwrap']('_ZN15running_machine10nvram_saveEv', '', ['number']);
+
+// Save states to and from an absolute path, which lives in MEMFS.
+JSMESS.save_state = function(path) {
+	JSMESS.machine_save(JSMESS.get_machine(), path);
+};
+JSMESS.load_state = function(path) {
+	JSMESS.machine_load(JSMESS.get_machine(), path);
+};
+// MAME otherwise writes NVRAM only when the machine exits.
+JSMESS.nvram_save = function() {
+	var machine = JSMESS.get_machine();
+	if (machine) {
+		JSMESS.machine_nvram_save(machine);
+	}
+};
+JSMESS.read_file = function(path) {
+	return FS.readFile(path, { encoding: 'binary' });
+};
+JSMESS.write_file = function(path, data) {
+	FS.writeFile(path, data, { encoding: 'binary' });
+};
+JSMESS.file_size = function(path) {
+	return FS.stat(path).size;
+};
+JSMESS.read_range = function(path, position, length) {
+	var stream = FS.open(path, 'r');
+	var data = new Uint8Array(length);
+	var read = FS.read(stream, data, 0, length, position);
+	FS.close(stream);
+	return read < length ? data.slice(0, read) : data;
+};
+JSMESS.write_range = function(path, data, position) {
+	var stream = FS.open(path, FS.analyzePath(path).exists ? 'r+' : 'w+');
+	FS.write(stream, data, 0, data.length, position);
+	FS.close(stream);
+};
+JSMESS.truncate = function(path, size) {
+	FS.truncate(path, size);
+};
+// Deletes the file if it exists.
+JSMESS.remove_file = function(path) {
+	if (FS.analyzePath(path).exists) {
+		FS.unlink(path);
+	}
+};
+// Creates the directory and any missing parents.
+JSMESS.mkdir = function(path) {
+	var dir = '';
+	path.split('/').forEach(function(part) {
+		if (part === '') {
+			return;
+		}
+		dir += '/' + part;
+		try {
+			FS.mkdir(dir);
+		} catch (e) {
+		}
+	});
+};
+// Calls callback(path, position, length) after every write to a MEMFS file.
+// File nodes don't call MEMFS.stream_ops but the table MEMFS.ops_table copied
+// from it when the filesystem started, and open streams share their node's
+// table, so the write is replaced in all of those.
+JSMESS.on_file_write = function(callback) {
+	var write = MEMFS.stream_ops.write;
+	var hooked = function(stream, buffer, offset, length, position, canOwn) {
+		var written = write.apply(this, arguments);
+		if (written > 0) {
+			callback(FS.getPath(stream.node), position, written);
+		}
+		return written;
+	};
+	MEMFS.stream_ops.write = hooked;
+	if (MEMFS.ops_table) {
+		MEMFS.ops_table.file.stream.write = hooked;
+	}
+	for (var i = 0; i < FS.nameTable.length; i++) {
+		for (var node = FS.nameTable[i]; node; node = node.name_next) {
+			if (node.stream_ops && node.stream_ops.write === write) {
+				node.stream_ops.write = hooked;
+			}
+		}
+	}
+};
+
+// C++ symbol names for the profiler. Only meaningful with PROFILE=1 builds.
+JSMESS.demangle = (typeof demangle === 'function') ? demangle : null;
+
+// Runs one iteration of the emscripten main loop (1/60s of emulated time)
+// outside of the normal requestAnimationFrame schedule.
+JSMESS.run_frame = function() {
+	var func = Browser.mainLoop.func;
+	if (typeof func === 'number') {
+		Runtime.dynCall('v', func);
+	} else {
+		func();
+	}
+};
@@ -1,4 +1,4 @@
-if(!window.console){ window.console = {log: function(){} }; }
+if(typeof window !== 'undefined' && !window.console){ window.console = {log: function(){} }; }
 var JSMESS = JSMESS || {};
 JSMESS.running = false;
 JSMESS.ready(function() { console.log("JSMESS is now running"); });
@@ -0,0 +1,308 @@
+// jsmess predictive prefetch for launcher and gallery pages
+//
+// A launcher links to one JSMESS page per system or game. Without help the
+// engine, its .mem file and the BIOS only start downloading after the click.
+// This warms the browser cache for a link while the user is about to click
+// it: when it is hovered, focused or scrolled into view. Downloads run one at
+// a time, start when the browser is idle, stop when the user moves on (the
+// pointer leaves, focus moves, the link scrolls away) and stay within a byte
+// budget per page. Nothing is kept in JS; the game page's loader finds the
+// files in the HTTP cache, so the server must send cacheable responses.
+//
+// Links list the files of their page, as the page's loader requests them:
+//
+//   <a href="coleco/index.html"
+//      data-jsmess-prefetch="coleco/messcoleco.js coleco/messcoleco.js.mem coleco/coleco.zip">
+//
+// `make prefetch-urls` prints that list for a system, relative to its page.
+// Those are picked up when the page loads; other elements can be added with
+// JSMESS.prefetch.watch(element, urls). Included in a game page, this script
+// instead checks which of the page's files were warmed and counts hits.
+//
+//   JSMESS.prefetch.stats();   // on the launcher: bytes, cancels, hit rate
+
+var JSMESS = JSMESS || {};
+
+JSMESS.prefetch = (function () {
+
+var config = {
+	// bytes a page may prefetch in total
+	budget_bytes: 64 * 1024 * 1024,
+	// how long a hover or focus has to last before downloading starts
+	hover_delay_ms: 100,
+	// also warm links as they scroll into view
+	viewport: true,
+	// don't prefetch on metered or data saver connections
+	respect_save_data: true,
+	// warmed files not launched within this long are not counted as misses
+	forget_ms: 24 * 60 * 60 * 1000,
+	// shared with the game pages of the same origin
+	storage_key: 'jsmess-prefetch'
+};
+
+var queue = [];             // [{ url, owners }], waiting for idle time
+var current = null;         // { url, owners, xhr }
+var done = {};              // url -> bytes
+var spent = 0;
+var observer = null;
+var stats = {
+	requested: 0,
+	completed: 0,
+	cancelled: 0,
+	over_budget: 0,
+	bytes: 0,
+	bytes_wasted: 0,        // downloaded by cancelled requests
+	clicks: 0,
+	clicks_ready: 0         // clicks with every file already warm
+};
+
+function absolute (url) {
+	var a = document.createElement('a');
+	a.href = url;
+	return a.href;
+};
+
+function load_shared () {
+	try {
+		return JSON.parse(localStorage.getItem(config.storage_key)) || { warmed: {}, hits: 0, misses: 0 };
+	} catch (e) {
+		return { warmed: {}, hits: 0, misses: 0 };
+	}
+};
+
+function save_shared (shared) {
+	try {
+		localStorage.setItem(config.storage_key, JSON.stringify(shared));
+	} catch (e) {
+	}
+};
+
+function allowed () {
+	var c = navigator.connection;
+	if (config.respect_save_data && c && (c.saveData || /(^|-)2g$/.test(c.effectiveType || ''))) {
+		return false;
+	}
+	return spent < config.budget_bytes;
+};
+
+function idle (fn) {
+	if (window.requestIdleCallback) {
+		requestIdleCallback(fn, { timeout: 1000 });
+	} else {
+		setTimeout(fn, 50);
+	}
+};
+
+function pump () {
+	if (current || queue.length === 0) return;
+	idle(start_next);
+};
+
+function start_next () {
+	if (current || queue.length === 0) return;
+	var item = queue.shift();
+	if (item.url in done) {
+		pump();
+		return;
+	}
+	if (!allowed()) {
+		stats.over_budget++;
+		pump();
+		return;
+	}
+	var xhr = new XMLHttpRequest();
+	current = { url: item.url, owners: item.owners, xhr: xhr, loaded: 0 };
+	stats.requested++;
+	xhr.open('GET', item.url, true);
+	xhr.responseType = 'arraybuffer';
+	xhr.onprogress = function (e) {
+		current.loaded = e.loaded;
+		// Give up on files that would take us over the budget.
+		var total = e.lengthComputable ? e.total : e.loaded;
+		if (spent + total > config.budget_bytes) {
+			stats.over_budget++;
+			finish(true);
+		}
+	};
+	xhr.onload = function () {
+		var bytes = xhr.response ? xhr.response.byteLength : 0;
+		if (xhr.status >= 200 && xhr.status < 300) {
+			done[item.url] = bytes;
+			stats.completed++;
+			var shared = load_shared();
+			var now = Date.now();
+			for (var url in shared.warmed) {
+				if (now - shared.warmed[url] > config.forget_ms) delete shared.warmed[url];
+			}
+			shared.warmed[item.url] = now;
+			save_shared(shared);
+		}
+		spent += bytes;
+		stats.bytes += bytes;
+		current = null;
+		pump();
+	};
+	xhr.onerror = function () {
+		current = null;
+		pump();
+	};
+	xhr.send();
+};
+
+// Stops the download in flight, cancelling it when aborting is true, and
+// moves on to the next queued file.
+function finish (aborting) {
+	if (!current) return;
+	if (aborting) {
+		current.xhr.onload = current.xhr.onerror = current.xhr.onprogress = null;
+		current.xhr.abort();
+		stats.cancelled++;
+		stats.bytes_wasted += current.loaded;
+		spent += current.loaded;
+	}
+	current = null;
+	pump();
+};
+
+// A file wanted by several owners (say, a link both hovered and in view) is
+// fetched once and only cancelled when none of them wants it any more.
+function add_owner (item, owner) {
+	if (item.owners.indexOf(owner) < 0) item.owners.push(owner);
+};
+
+function drop_owner (item, owner) {
+	item.owners = item.owners.filter(function (o) { return o !== owner; });
+	return item.owners.length > 0;
+};
+
+function warm (urls, owner) {
+	urls.forEach(function (url) {
+		url = absolute(url);
+		if (url in done) return;
+		if (current && current.url === url) {
+			add_owner(current, owner);
+			return;
+		}
+		for (var i = 0; i < queue.length; i++) {
+			if (queue[i].url === url) {
+				add_owner(queue[i], owner);
+				return;
+			}
+		}
+		queue.push({ url: url, owners: [owner] });
+	});
+	pump();
+};
+
+function cancel (owner) {
+	queue = queue.filter(function (item) { return drop_owner(item, owner); });
+	if (current && !drop_owner(current, owner)) {
+		finish(true);
+	}
+};
+
+function ready (urls) {
+	return urls.every(function (url) { return absolute(url) in done; });
+};
+
+function watch (element, urls) {
+	if (typeof urls === 'string') {
+		urls = urls.split(/\s+/).filter(function (u) { return u !== ''; });
+	}
+	// Hover or focus and the viewport ask for the files separately, so
+	// leaving the link doesn't cancel what scrolling it into view started.
+	var hover = { element: element, by: 'hover' };
+	var timer = null;
+	var engage = function () {
+		clearTimeout(timer);
+		timer = setTimeout(function () { warm(urls, hover); }, config.hover_delay_ms);
+	};
+	var disengage = function () {
+		clearTimeout(timer);
+		cancel(hover);
+	};
+	element.addEventListener('mouseenter', engage);
+	element.addEventListener('focus', engage);
+	element.addEventListener('touchstart', engage);
+	element.addEventListener('mouseleave', disengage);
+	element.addEventListener('blur', disengage);
+	element.addEventListener('click', function () {
+		stats.clicks++;
+		if (ready(urls)) stats.clicks_ready++;
+	});
+	if (config.viewport && window.IntersectionObserver) {
+		if (!observer) {
+			observer = new IntersectionObserver(function (entries) {
+				entries.forEach(function (entry) {
+					var watched = entry.target.jsmess_prefetch;
+					if (entry.isIntersecting) {
+						warm(watched.urls, watched.owner);
+					} else {
+						cancel(watched.owner);
+					}
+				});
+			}, { threshold: 0.5 });
+		}
+		element.jsmess_prefetch = { urls: urls, owner: { element: element, by: 'viewport' } };
+		observer.observe(element);
+	}
+};
+
+function scan () {
+	var elements = document.querySelectorAll('[data-jsmess-prefetch]');
+	for (var i = 0; i < elements.length; i++) {
+		watch(elements[i], elements[i].getAttribute('data-jsmess-prefetch'));
+	}
+};
+
+// On a game page: count the page's files that a launcher had warmed and
+// whether the cache still had them (nothing transferred). Cross-origin files
+// served without Timing-Allow-Origin report zero sizes either way and are
+// not counted.
+function check () {
+	if (!window.performance || !performance.getEntriesByType) return;
+	var shared = load_shared();
+	var changed = false;
+	performance.getEntriesByType('resource').forEach(function (entry) {
+		if (!(entry.name in shared.warmed)) return;
+		if (entry.transferSize === 0 && entry.decodedBodySize === 0) return;
+		if (entry.transferSize === 0) {
+			shared.hits++;
+		} else {
+			shared.misses++;
+		}
+		delete shared.warmed[entry.name];
+		changed = true;
+	});
+	if (changed) save_shared(shared);
+};
+
+if (typeof JSMESS.ready === 'function' && typeof Module !== 'undefined') {
+	JSMESS.ready(check);
+} else if (document.readyState === 'loading') {
+	document.addEventListener('DOMContentLoaded', scan);
+} else {
+	scan();
+}
+
+return {
+	config: config,
+	watch: watch,
+	warm: function (urls) { warm(urls, null); },
+	cancel: function () { queue = []; finish(true); },
+	ready: ready,
+	stats: function () {
+		var shared = load_shared();
+		var s = {};
+		for (var k in stats) s[k] = stats[k];
+		s.budget_left = Math.max(0, config.budget_bytes - spent);
+		s.click_hit_rate = stats.clicks ? stats.clicks_ready / stats.clicks : null;
+		// files warmed here and found in the cache by a game page
+		s.cache_hits = shared.hits;
+		s.cache_misses = shared.misses;
+		s.cache_hit_rate = shared.hits + shared.misses ? shared.hits / (shared.hits + shared.misses) : null;
+		return s;
+	}
+};
+
+})();
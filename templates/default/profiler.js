@@ -0,0 +1,153 @@
+// jsmess sampling profiler
+//
+// Samples the page with the JS Self-Profiling API (Chromium; the page must be
+// served with a "Document-Policy: js-profiling" header) and attributes time
+// to C++ functions and to the devices they belong to. Build with PROFILE=1 so
+// the optimized engine keeps its function names.
+//
+//   JSMESS.profiler.start();
+//   ... play for a while ...
+//   JSMESS.profiler.stop().then(function (p) { console.log(p.devices); p.download(); });
+//
+// The folded stacks ("root;caller;callee count" per line) load directly into
+// flamegraph.pl, speedscope and friends. For mamebench-slowdown.sh, profile
+// the workload it runs natively with -bench <seconds>:
+//
+//   JSMESS.profiler.bench(30);   // downloads jsmess.folded when done
+
+var JSMESS = JSMESS || {};
+
+JSMESS.profiler = (function () {
+
+var profiler = null;
+var names = {};
+var frames = 0;
+
+function count_frame () {
+	frames++;
+};
+
+function demangle (name) {
+	if (names[name] !== undefined) return names[name];
+	var result = name;
+	try {
+		if (JSMESS.demangle) result = JSMESS.demangle(name) || name;
+	} catch (e) {
+	}
+	return (names[name] = result.replace(/;/g, ','));
+};
+
+// "z80_device::execute_run()" -> "z80_device". Devices and driver states
+// are the interesting owners; anything else is left to the caller.
+function owner (name) {
+	var m = /^(?:[\w:]*::)?(\w+_(?:device|state))::/.exec(name);
+	return m ? m[1] : null;
+};
+
+function start (sample_interval_ms) {
+	if (typeof Profiler === 'undefined') {
+		console.log('JSMESS profiler: the JS Self-Profiling API is not available ' +
+			'(Chromium only, needs the "Document-Policy: js-profiling" header)');
+		return false;
+	}
+	profiler = new Profiler({
+		sampleInterval: sample_interval_ms || 1,
+		maxBufferSize: 1000000
+	});
+	frames = 0;
+	JSMESS.post_frame_hooks.push(count_frame);
+	return true;
+};
+
+// Resolves to { samples, interval_ms, emulated_seconds, functions, devices,
+// folded, download }, with functions and devices as [name, self samples]
+// sorted by samples.
+function stop () {
+	if (!profiler) return Promise.reject(new Error('profiler not running'));
+	var p = profiler;
+	profiler = null;
+	JSMESS.remove_post_frame_hook(count_frame);
+	var emulated = frames / 60;  // one main loop iteration is 1/60s
+	return p.stop().then(function (trace) {
+		var result = summarize(trace);
+		result.emulated_seconds = emulated;
+		console.log('JSMESS profiler: ' + result.samples + ' samples every ' +
+			result.interval_ms.toFixed(2) + 'ms over ' + emulated.toFixed(1) +
+			' emulated seconds (mamebench-slowdown.sh -t ' + emulated.toFixed(1) +
+			' -i ' + result.interval_ms.toFixed(2) + ')');
+		return result;
+	});
+};
+
+// Profiles JSMESS.benchmark over exactly `seconds` of emulated time and
+// downloads the folded stacks.
+function bench (seconds, sample_interval_ms) {
+	if (!start(sample_interval_ms)) return;
+	JSMESS.benchmark(seconds, function () {
+		// run_frame bypasses the post frame hooks that count frames.
+		frames = Math.round(seconds * 60);
+		stop().then(function (p) { p.download(); });
+	}, true);
+};
+
+function summarize (trace) {
+	var stacks = {};
+	var self = {};
+	var devices = {};
+	var total = 0;
+
+	var frame_names = trace.frames.map(function (f) { return demangle(f.name || '(anonymous)'); });
+
+	for (var i = 0; i < trace.samples.length; i++) {
+		var id = trace.samples[i].stackId;
+		if (id === undefined) continue;
+		var path = [];
+		var device = null;
+		for (var s = trace.stacks[id]; s; s = (s.parentId === undefined) ? null : trace.stacks[s.parentId]) {
+			var name = frame_names[s.frameId];
+			path.push(name);
+			if (!device) device = owner(name);
+		}
+		total++;
+		var leaf = path[0];
+		self[leaf] = (self[leaf] || 0) + 1;
+		device = device || '(no device)';
+		devices[device] = (devices[device] || 0) + 1;
+		var folded = path.reverse().join(';');
+		stacks[folded] = (stacks[folded] || 0) + 1;
+	}
+
+	var sorted = function (counts) {
+		return Object.keys(counts)
+			.map(function (k) { return [k, counts[k]]; })
+			.sort(function (a, b) { return b[1] - a[1]; });
+	};
+	var folded = Object.keys(stacks).map(function (k) { return k + ' ' + stacks[k]; }).join('\n') + '\n';
+	// The actual interval, which the browser is free to stretch.
+	var n = trace.samples.length;
+	var interval = n > 1 ? (trace.samples[n - 1].timestamp - trace.samples[0].timestamp) / (n - 1) : 0;
+
+	return {
+		samples: total,
+		interval_ms: interval,
+		functions: sorted(self),
+		devices: sorted(devices),
+		folded: folded,
+		download: function (filename) {
+			var a = document.createElement('a');
+			a.href = URL.createObjectURL(new Blob([folded], { type: 'text/plain' }));
+			a.download = filename || 'jsmess.folded';
+			document.body.appendChild(a);
+			a.click();
+			document.body.removeChild(a);
+		}
+	};
+};
+
+return {
+	start: start,
+	stop: stop,
+	bench: bench
+};
+
+})();
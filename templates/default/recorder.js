@@ -0,0 +1,463 @@
+// jsmess gameplay recording
+//
+// Records what the emulator draws and mixes into a Matroska file (VP8 video,
+// 16-bit PCM audio) without MediaRecorder and without encoding on the main
+// thread. Every emulated frame's image and every audio block is copied once
+// into a pooled buffer and transferred to a worker, which encodes the video
+// with WebCodecs and hands the buffers back for reuse. The main thread only
+// pays for that copy.
+//
+// Timestamps come from emulated time, not the wall clock: video frame n is at
+// n/60 s and audio runs on its own sample count, so the clip stays in sync
+// and complete however slowly the page runs. Nothing is dropped; if the
+// encoder falls behind, frames wait in the worker and stats() shows the
+// backlog. Frames the emulator skipped repeat the previous image, and
+// stretches without sound (fast loading) are recorded as silence.
+//
+//   JSMESS.recorder.start();
+//   JSMESS.recorder.stats();   // frames, backlog, main thread ms per frame
+//   JSMESS.recorder.stop(function (blob) { ... });   // or save('clip.mkv')
+//
+// Needs WebCodecs (VideoEncoder) and workers.
+
+var JSMESS = JSMESS || {};
+
+JSMESS.recorder = (function () {
+
+var FRAME_RATE = 60;        // one main loop iteration per emulated frame
+
+var defaults = {
+	bitrate: 2000000,
+	keyframe_interval: 120
+};
+
+var worker = null;
+var active = false;
+var pools = {};             // size class -> ArrayBuffers back from the worker
+var pending = null;         // { buffer, width, height } drawn this frame
+var frame = 0;
+var done_callback = null;
+var last = null;
+var stats = null;
+
+function now () {
+	return window.performance ? performance.now() : Date.now();
+};
+
+function supported () {
+	return typeof Worker !== 'undefined' && typeof VideoEncoder !== 'undefined' &&
+		typeof VideoFrame !== 'undefined';
+};
+
+// Buffers are allocated in power of two size classes, so audio blocks and
+// video frames never take each other's buffers and a buffer's byteLength
+// names its pool.
+function size_class (bytes) {
+	var size = 4096;
+	while (size < bytes) size *= 2;
+	return size;
+};
+
+function acquire (bytes) {
+	var size = size_class(bytes);
+	var pool = pools[size];
+	if (pool && pool.length) return pool.pop();
+	stats.buffers_allocated++;
+	return new ArrayBuffer(size);
+};
+
+function release (buffer) {
+	(pools[buffer.byteLength] || (pools[buffer.byteLength] = [])).push(buffer);
+};
+
+// JSMESS.present hook: keeps the last image drawn during this frame.
+function on_present (image) {
+	var start = now();
+	var bytes = image.width * image.height * 4;
+	if (!pending || pending.buffer.byteLength < bytes) {
+		if (pending) release(pending.buffer);
+		pending = { buffer: acquire(bytes) };
+	}
+	new Uint8Array(pending.buffer, 0, bytes).set(image.data);
+	pending.width = image.width;
+	pending.height = image.height;
+	stats.main_ms += now() - start;
+};
+
+// Audio capture: copies the block out of the heap before it is played.
+function on_audio (pointer, samples) {
+	var start = now();
+	var count = samples * 2;
+	var buffer = acquire(count * 2);
+	var from = (pointer / 2) | 0;
+	new Int16Array(buffer, 0, count).set(Module['HEAP16'].subarray(from, from + count));
+	worker.postMessage({ type: 'audio', buffer: buffer, samples: samples, frame: frame }, [buffer]);
+	stats.audio_blocks++;
+	stats.in_flight++;
+	stats.main_ms += now() - start;
+};
+
+// Post-frame hook: one video frame per emulated frame.
+function on_frame () {
+	var start = now();
+	if (pending) {
+		worker.postMessage({
+			type: 'frame', buffer: pending.buffer, width: pending.width,
+			height: pending.height, frame: frame
+		}, [pending.buffer]);
+		pending = null;
+		stats.in_flight++;
+	} else {
+		worker.postMessage({ type: 'repeat', frame: frame });
+		stats.repeated++;
+	}
+	frame++;
+	stats.frames++;
+	stats.max_backlog = Math.max(stats.max_backlog, stats.frames - stats.encoded);
+	stats.main_ms += now() - start;
+};
+
+function on_message (e) {
+	var m = e.data;
+	if (m.type === 'buffer') {
+		release(m.buffer);
+		stats.in_flight--;
+	} else if (m.type === 'progress') {
+		stats.encoded = m.encoded;
+		stats.encoder_queue = m.queue;
+	} else if (m.type === 'done') {
+		last = get_stats();
+		last.bytes = m.blob.size;
+		worker.terminate();
+		worker = null;
+		pools = {};
+		if (done_callback) done_callback(m.blob);
+	} else if (m.type === 'error') {
+		console.log('JSMESS recorder: ' + m.message);
+	}
+};
+
+function start (options) {
+	if (active) return true;
+	if (!supported()) {
+		console.log('JSMESS recorder: this browser has no WebCodecs video encoder');
+		return false;
+	}
+	var config = {};
+	for (var k in defaults) config[k] = defaults[k];
+	for (var k in options) config[k] = options[k];
+	config.frame_rate = FRAME_RATE;
+	config.sample_rate = jsmess_web_audio.get_emulator_rate() || 48000;
+
+	var source = '(' + worker_main.toString() + ')();';
+	worker = new Worker(URL.createObjectURL(new Blob([source], { type: 'text/javascript' })));
+	worker.onmessage = on_message;
+	worker.postMessage({ type: 'start', config: config });
+
+	active = true;
+	frame = 0;
+	pending = null;
+	last = null;
+	stats = {
+		frames: 0,
+		repeated: 0,
+		audio_blocks: 0,
+		encoded: 0,
+		encoder_queue: 0,
+		in_flight: 0,
+		max_backlog: 0,
+		buffers_allocated: 0,
+		main_ms: 0,
+		started_at: now()
+	};
+	JSMESS.present.hooks.push(on_present);
+	jsmess_web_audio.set_capture(on_audio);
+	JSMESS.post_frame_hooks.push(on_frame);
+	return true;
+};
+
+function stop (callback) {
+	if (!active) return;
+	active = false;
+	JSMESS.remove_post_frame_hook(on_frame);
+	jsmess_web_audio.set_capture(null);
+	var hooks = JSMESS.present.hooks;
+	hooks.splice(hooks.indexOf(on_present), 1);
+	pending = null;
+	done_callback = callback || null;
+	worker.postMessage({ type: 'stop' });
+};
+
+function save (filename) {
+	stop(function (blob) {
+		var a = document.createElement('a');
+		a.href = URL.createObjectURL(blob);
+		a.download = filename || (Module['arguments'][0] + '.mkv');
+		document.body.appendChild(a);
+		a.click();
+		document.body.removeChild(a);
+	});
+};
+
+function get_stats () {
+	if (!stats) return last;
+	var wall = (now() - stats.started_at) / 1000;
+	return {
+		recording: active,
+		seconds: stats.frames / FRAME_RATE,
+		frames: stats.frames,
+		repeated_frames: stats.repeated,
+		audio_blocks: stats.audio_blocks,
+		// frames captured but not encoded yet
+		backlog_frames: stats.frames - stats.encoded,
+		max_backlog_frames: stats.max_backlog,
+		encoder_queue: stats.encoder_queue,
+		buffers_in_flight: stats.in_flight,
+		buffers_allocated: stats.buffers_allocated,
+		main_ms_per_frame: stats.frames ? stats.main_ms / stats.frames : 0,
+		encode_speed: wall > 0 ? (stats.encoded / FRAME_RATE) / wall : 0
+	};
+};
+
+// Runs in the worker; must not use anything from the page.
+function worker_main () {
+	var config = null;
+	var encoder = null;
+	var last_frame = null;       // VideoFrame, for repeats
+	var encoded = 0;
+	var video = [];              // { time, key, data }, time in ms
+	var audio = [];
+	var audio_samples = 0;
+	var width = 0;               // size of the first frame
+	var height = 0;
+	var encoder_width = 0;
+	var encoder_height = 0;
+	var stopping = false;
+
+	function fail (message) {
+		self.postMessage({ type: 'error', message: message });
+	}
+
+	function progress () {
+		self.postMessage({ type: 'progress', encoded: encoded, queue: encoder ? encoder.encodeQueueSize : 0 });
+	}
+
+	function configure (w, h) {
+		// Matroska takes the size from the first frame; VP8 carries later
+		// changes in its keyframes.
+		if (!width) {
+			width = w;
+			height = h;
+		}
+		if (!encoder) {
+			encoder = new VideoEncoder({
+				output: function (chunk) {
+					var data = new Uint8Array(chunk.byteLength);
+					chunk.copyTo(data);
+					video.push({ time: chunk.timestamp / 1000, key: chunk.type === 'key', data: data });
+					encoded++;
+					if (encoded % 30 === 0) progress();
+				},
+				error: function (e) { fail(e.message); }
+			});
+		}
+		encoder.configure({
+			codec: 'vp8',
+			width: w,
+			height: h,
+			bitrate: config.bitrate,
+			framerate: config.frame_rate,
+			latencyMode: 'realtime'
+		});
+	}
+
+	function encode (videoframe, index) {
+		if (videoframe.codedWidth !== encoder_width || videoframe.codedHeight !== encoder_height) {
+			encoder_width = videoframe.codedWidth;
+			encoder_height = videoframe.codedHeight;
+			configure(encoder_width, encoder_height);
+			encoder.encode(videoframe, { keyFrame: true });
+		} else {
+			encoder.encode(videoframe, { keyFrame: index % config.keyframe_interval === 0 });
+		}
+	}
+
+	function on_frame (m) {
+		var timestamp = Math.round(m.frame * 1e6 / config.frame_rate);
+		var f = new VideoFrame(new Uint8Array(m.buffer, 0, m.width * m.height * 4), {
+			format: 'RGBX', codedWidth: m.width, codedHeight: m.height, timestamp: timestamp
+		});
+		// The frame holds its own copy; the buffer can go back to the pool.
+		self.postMessage({ type: 'buffer', buffer: m.buffer }, [m.buffer]);
+		encode(f, m.frame);
+		if (last_frame) last_frame.close();
+		last_frame = f;
+	}
+
+	function on_repeat (m) {
+		if (!last_frame) {
+			encoded++;
+			return;
+		}
+		var f = new VideoFrame(last_frame, { timestamp: Math.round(m.frame * 1e6 / config.frame_rate) });
+		encode(f, m.frame);
+		f.close();
+	}
+
+	function on_audio (m) {
+		// Fill gaps (emulation ran with sound off) with silence.
+		var expected = Math.round(m.frame * config.sample_rate / config.frame_rate);
+		var slack = Math.round(2 * config.sample_rate / config.frame_rate);
+		if (expected - audio_samples > slack) {
+			var silence = expected - audio_samples;
+			audio.push({ time: audio_samples * 1000 / config.sample_rate, key: true, data: new Uint8Array(silence * 4) });
+			audio_samples += silence;
+		}
+		var data = new Uint8Array(m.samples * 4);
+		data.set(new Uint8Array(m.buffer, 0, m.samples * 4));
+		self.postMessage({ type: 'buffer', buffer: m.buffer }, [m.buffer]);
+		audio.push({ time: audio_samples * 1000 / config.sample_rate, key: true, data: data });
+		audio_samples += m.samples;
+	}
+
+	// Matroska writing. Elements are lists of byte arrays; sizes are always
+	// written as 8-byte vints.
+	function flatten (body, out) {
+		for (var i = 0; i < body.length; i++) {
+			if (body[i] instanceof Uint8Array) out.push(body[i]);
+			else flatten(body[i], out);
+		}
+		return out;
+	}
+	function el (id, body) {
+		var pieces = flatten(body, []);
+		var n = 0;
+		for (var i = 0; i < pieces.length; i++) n += pieces[i].length;
+		var size = new Uint8Array(8);
+		size[0] = 0x01;
+		for (var i = 7; i >= 1; i--) {
+			size[i] = n % 256;
+			n = Math.floor(n / 256);
+		}
+		return [new Uint8Array(id), size].concat(pieces);
+	}
+	function uint (id, v) {
+		var bytes = [];
+		do {
+			bytes.unshift(v % 256);
+			v = Math.floor(v / 256);
+		} while (v > 0);
+		return el(id, [new Uint8Array(bytes)]);
+	}
+	function str (id, s) {
+		var bytes = new Uint8Array(s.length);
+		for (var i = 0; i < s.length; i++) bytes[i] = s.charCodeAt(i);
+		return el(id, [bytes]);
+	}
+	function flt (id, v) {
+		var bytes = new Uint8Array(8);
+		new DataView(bytes.buffer).setFloat64(0, v);
+		return el(id, [bytes]);
+	}
+	function block (track, relative, key, data) {
+		var header = new Uint8Array([0x80 | track, (relative >> 8) & 0xff, relative & 0xff, key ? 0x80 : 0]);
+		return el([0xA3], [header, data]);
+	}
+
+	function mux () {
+		var blocks = [];
+		video.forEach(function (b) { b.track = 1; blocks.push(b); });
+		audio.forEach(function (b) { b.track = 2; blocks.push(b); });
+		blocks.sort(function (a, b) { return a.time - b.time || a.track - b.track; });
+
+		var clusters = [];
+		var cluster = null;
+		var cluster_time = 0;
+		blocks.forEach(function (b) {
+			var time = Math.round(b.time);
+			if (!cluster || (b.track === 1 && b.key) || time - cluster_time > 30000) {
+				if (cluster) clusters.push(el([0x1F, 0x43, 0xB6, 0x75], cluster));
+				cluster_time = time;
+				cluster = [uint([0xE7], time)];
+			}
+			cluster.push(block(b.track, time - cluster_time, b.key, b.data));
+		});
+		if (cluster) clusters.push(el([0x1F, 0x43, 0xB6, 0x75], cluster));
+
+		var duration = Math.max(video.length ? video[video.length - 1].time + 1000 / config.frame_rate : 0,
+			audio_samples * 1000 / config.sample_rate);
+		var header = el([0x1A, 0x45, 0xDF, 0xA3], [
+			uint([0x42, 0x86], 1), uint([0x42, 0xF7], 1), uint([0x42, 0xF2], 4), uint([0x42, 0xF3], 8),
+			str([0x42, 0x82], 'matroska'), uint([0x42, 0x87], 4), uint([0x42, 0x85], 2)
+		]);
+		var info = el([0x15, 0x49, 0xA9, 0x66], [
+			uint([0x2A, 0xD7, 0xB1], 1000000),
+			str([0x4D, 0x80], 'jsmess'), str([0x57, 0x41], 'jsmess'),
+			flt([0x44, 0x89], duration)
+		]);
+		var tracks = el([0x16, 0x54, 0xAE, 0x6B], [
+			el([0xAE], [
+				uint([0xD7], 1), uint([0x73, 0xC5], 1), uint([0x83], 1), uint([0x9C], 0),
+				str([0x86], 'V_VP8'),
+				el([0xE0], [uint([0xB0], width || 1), uint([0xBA], height || 1)])
+			]),
+			el([0xAE], [
+				uint([0xD7], 2), uint([0x73, 0xC5], 2), uint([0x83], 2), uint([0x9C], 0),
+				str([0x86], 'A_PCM/INT/LIT'),
+				el([0xE1], [flt([0xB5], config.sample_rate), uint([0x9F], 2), uint([0x62, 0x64], 16)])
+			])
+		]);
+		var segment = el([0x18, 0x53, 0x80, 0x67], [info, tracks].concat(clusters));
+		return new Blob(flatten([header, segment], []), { type: 'video/x-matroska' });
+	}
+
+	self.onmessage = function (e) {
+		var m = e.data;
+		try {
+			if (m.type === 'start') {
+				config = m.config;
+			} else if (m.type === 'frame') {
+				on_frame(m);
+			} else if (m.type === 'repeat') {
+				on_repeat(m);
+			} else if (m.type === 'audio') {
+				on_audio(m);
+			} else if (m.type === 'stop' && !stopping) {
+				stopping = true;
+				var flushed = encoder ? encoder.flush() : Promise.resolve();
+				flushed.then(function () {
+					if (last_frame) last_frame.close();
+					progress();
+					self.postMessage({ type: 'done', blob: mux() });
+				}, function (err) { fail(err.message); });
+			}
+		} catch (err) {
+			fail(err.message);
+		}
+	};
+}
+
+// The page's Record link starts recording and saves the clip when clicked
+// again.
+var link = document.getElementById('record');
+if (link) {
+	link.addEventListener('click', function () {
+		if (active) {
+			save();
+			link.textContent = 'Record';
+		} else if (JSMESS.running && start()) {
+			link.textContent = 'Stop recording';
+		}
+	});
+}
+
+return {
+	config: defaults,
+	supported: supported,
+	start: start,
+	stop: stop,
+	save: save,
+	stats: get_stats
+};
+
+})();
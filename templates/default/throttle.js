@@ -0,0 +1,152 @@
+// jsmess display-paced throttling
+//
+// MAME's own throttle has no way to sleep in the browser: a system faster
+// than real time waits for the wall clock inside the main loop, burning a
+// core for nothing. Instead the emulator runs with -nothrottle and the pacing
+// is done here, on the display callbacks the main loop already runs on: a
+// callback that finds emulated time ahead of real time skips its iteration
+// and the page sleeps until the next one. On a 120Hz display every other
+// callback is skipped; on a display slower than 60Hz, or after a slow frame,
+// up to max_catchup extra frames run in the same callback.
+//
+// stats() reports the speed and how much of the wall time the main loop left
+// idle. ?throttle=mame in the URL keeps MAME's throttle instead, to compare.
+//
+//   JSMESS.throttle.stats();
+//   JSMESS.throttle.report();   // mamebench line, "cpu.js"
+
+var JSMESS = JSMESS || {};
+
+JSMESS.throttle = (function () {
+
+var FRAME_MS = 1000 / 60;   // one main loop iteration
+
+var config = {
+	// extra frames one callback may run to catch up
+	max_catchup: 3,
+	// further behind than this (a slow system, a background tab) restarts
+	// the pacing instead of fast-forwarding to catch up
+	max_lag_frames: 10
+};
+
+var enabled = !/[?&]throttle=mame(&|$)/.test(window.location.search);
+var base = null;            // wall time of emulated frame 0
+var frames = 0;             // emulated frames since base
+var started = 0;            // iteration start, for busy time
+var in_catchup = false;
+var stats = null;
+var run_hooks = Module['postMainLoop'];
+
+function now () {
+	return window.performance ? performance.now() : Date.now();
+};
+
+function reset_stats () {
+	stats = {
+		since: now(),
+		frames: 0,
+		callbacks: 0,
+		skipped: 0,
+		catchup: 0,
+		resyncs: 0,
+		busy_ms: 0
+	};
+};
+
+function fast_loading () {
+	return !!(JSMESS.fastload && JSMESS.fastload.is_active());
+};
+
+function pre_main_loop () {
+	var t = now();
+	stats.callbacks++;
+	if (!enabled) {
+		started = t;
+		return true;
+	}
+	if (base === null) {
+		base = t;
+		frames = 0;
+	}
+	var due = (t - base) / FRAME_MS;
+	if (due - frames > config.max_lag_frames) {
+		// Too far behind: carry on from here at normal speed.
+		base = t - frames * FRAME_MS;
+		stats.resyncs++;
+	} else if (frames > due) {
+		stats.skipped++;
+		return false;
+	}
+	started = t;
+	return true;
+};
+
+function post_main_loop () {
+	run_hooks();
+	frames++;
+	stats.frames++;
+	if (in_catchup) return;
+	var extra = 0;
+	// Catching up runs frames outside preMainLoop, so only while nothing
+	// (netplay, a benchmark) has taken it over. Fast loading already runs a
+	// batch of frames from its hook, which every caught up frame would run
+	// again.
+	if (enabled && Module['preMainLoop'] === pre_main_loop && !fast_loading()) {
+		in_catchup = true;
+		while (extra < config.max_catchup && frames + 1 <= (now() - base) / FRAME_MS) {
+			// run_frame bypasses the main loop hooks; run them as it would.
+			JSMESS.run_frame();
+			post_main_loop();
+			extra++;
+		}
+		in_catchup = false;
+	}
+	stats.catchup += extra;
+	stats.busy_ms += now() - started;
+};
+
+function get_stats () {
+	var wall = now() - stats.since;
+	var busy = wall > 0 ? Math.min(1, stats.busy_ms / wall) : 0;
+	return {
+		enabled: enabled,
+		speed: wall > 0 ? stats.frames * FRAME_MS / wall * 100 : 0,
+		busy_percent: busy * 100,
+		idle_percent: (1 - busy) * 100,
+		callbacks: stats.callbacks,
+		skipped: stats.skipped,
+		catchup_frames: stats.catchup,
+		resyncs: stats.resyncs
+	};
+};
+
+reset_stats();
+Module['preMainLoop'] = pre_main_loop;
+Module['postMainLoop'] = post_main_loop;
+if (enabled) {
+	Module['arguments'].push('-nothrottle');
+}
+// Background tabs get no callbacks; that isn't lag to catch up on.
+document.addEventListener('visibilitychange', function () {
+	base = null;
+});
+
+return {
+	config: config,
+	enabled: function () { return enabled; },
+	stats: get_stats,
+	reset: function () {
+		base = null;
+		reset_stats();
+	},
+	// Busy is the main loop's share of the wall time; idle is what is left
+	// for the rest of the page, the browser and sleep.
+	report: function () {
+		var s = get_stats();
+		var notes = 'throttle=' + (enabled ? 'js' : 'mame') + ';speed=' + s.speed.toFixed(1) +
+			'%;idle=' + s.idle_percent.toFixed(1) + '%';
+		return [JSMESS.bench_name(), '', s.busy_percent.toFixed(1) + '%', 'cpu.js', notes].join('\t');
+	}
+};
+
+})();
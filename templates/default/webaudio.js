@@ -12,15 +12,95 @@ var numChannels = 2; // constant in jsmess
 var sampleScale = 32766;
 var prebufferDuration = 100 / 1000;
 
+// 'interactive', 'balanced', 'playback' or a number of seconds.
+var latencyHint = 'interactive';
+// Emulated frames of jitter the prebuffer has to absorb on top of the
+// context's own render quantum.
+var jitterFrames = 2;
+var minPrebufferDuration = 40 / 1000;
+
+// Rate the emulator mixes at. null means the context rate, and MAME does all
+// the resampling; anything else is resampled here with the polyphase
+// resampler below (see set_resampling).
+var emulatorRate = null;
+var resampleQuality = 'quality';
+var resampler = null;
+var resample_left = null;
+var resample_right = null;
+
+// Called with every block the emulator mixes, before it is played (see
+// set_capture).
+var capture = null;
+
+// The one AudioContext for the page. The loader uses it for -samplerate and
+// the emulator plays through it; browsers cap the number of live contexts and
+// each one has its own render thread.
 function lazy_init () {
-  if (context || typeof AudioContext == 'undefined')
+  var AudioContextClass = window.AudioContext || window.webkitAudioContext;
+  if (context || !AudioContextClass)
     return;
 
-  context = new AudioContext();
+  try {
+    context = new AudioContextClass({ latencyHint: latencyHint });
+  } catch (e) {
+    context = new AudioContextClass();
+  }
 
   gain_node = context.createGain();
   gain_node.gain.value = 1.0;
   gain_node.connect(context.destination);
+
+  // Size the prebuffer from what the device actually needs instead of a
+  // fixed 100ms.
+  prebufferDuration = Math.max(
+    minPrebufferDuration,
+    (context.baseLatency || 0) + jitterFrames / 60
+  );
+
+  // Autoplay policies start contexts suspended until a user gesture.
+  var resume = function () {
+    if (context && context.state === 'suspended')
+      context.resume();
+  };
+  window.addEventListener('keydown', resume, true);
+  window.addEventListener('mousedown', resume, true);
+  window.addEventListener('touchend', resume, true);
+
+  // Don't hold the audio device while the page is in the back/forward cache.
+  window.addEventListener('pagehide', function () {
+    if (context && context.state === 'running')
+      context.suspend();
+  });
+  window.addEventListener('pageshow', resume);
+
+  var latency = get_latency();
+  console.log('JSMESS audio: ' + context.sampleRate + 'Hz, latency ' +
+    Math.round(latency.total * 1000) + 'ms (base ' +
+    Math.round(latency.base * 1000) + 'ms, output ' +
+    Math.round(latency.output * 1000) + 'ms, buffered ' +
+    Math.round(latency.buffered * 1000) + 'ms)');
+};
+
+function set_latency_hint (hint) {
+  latencyHint = hint;
+};
+
+// Effective end-to-end latency in seconds: our prebuffer plus the
+// context's processing and output latency.
+function get_latency () {
+  if (!context)
+    return null;
+  var base = context.baseLatency || 0;
+  var output = context.outputLatency || 0;
+  var buffered = (buffer_insert_point === null)
+    ? prebufferDuration
+    : Math.max(0, buffer_insert_point - context.currentTime);
+  return {
+    base: base,
+    output: output,
+    buffered: buffered,
+    total: base + output + buffered
+  };
 };
 
 function set_mastervolume (
@@ -50,43 +130,200 @@ function update_audio_stream (
   pBuffer,           // pointer into emscripten heap. int16 samples
   samples_this_frame // int. number of samples at pBuffer address.
 ) {
+  if (capture)
+    capture(pBuffer, samples_this_frame);
   lazy_init();
   if (!context) return;
 
-  var buffer = context.createBuffer(
-    numChannels, samples_this_frame, 
-    // JSMESS already initializes its mixer to use the context sampling rate.
-    context.sampleRate
-  );
+  // divide by sizeof(INT16) since pBuffer is offset in bytes
+  var start = (pBuffer / 2) | 0;
+  var samples = Module['HEAP16'].subarray(start, start + ((samples_this_frame * 2) | 0));
+  var buffer;
+
+  if (emulatorRate === null || emulatorRate === context.sampleRate) {
+    buffer = context.createBuffer(
+      numChannels, samples_this_frame,
+      // JSMESS already initializes its mixer to use the context sampling rate.
+      context.sampleRate
+    );
+    deinterleave(
+      samples, buffer.getChannelData(0), buffer.getChannelData(1),
+      samples_this_frame | 0
+    );
+  } else {
+    if (!resampler || resample_left.length < samples_this_frame) {
+      if (!resampler)
+        resampler = new Resampler(emulatorRate, context.sampleRate, resampleQuality);
+      resample_left = new Float32Array(samples_this_frame * 2);
+      resample_right = new Float32Array(samples_this_frame * 2);
+    }
+    deinterleave(samples, resample_left, resample_right, samples_this_frame | 0);
+    var count = resampler.process(resample_left, resample_right, samples_this_frame | 0);
+    if (count === 0) return;
+    buffer = context.createBuffer(numChannels, count, context.sampleRate);
+    buffer.getChannelData(0).set(resampler.out[0].subarray(0, count));
+    buffer.getChannelData(1).set(resampler.out[1].subarray(0, count));
+  }
+
+  pending_buffers.push(buffer);
 
-  for (
-    var channel_left  = buffer.getChannelData(0),
-        channel_right = buffer.getChannelData(1),
-        i = 0,
-        l = samples_this_frame | 0;
-    i < l;
-    i++
-  ) {
-    var offset = 
-      // divide by sizeof(INT16) since pBuffer is offset
-      //  in bytes
-      ((pBuffer / 2) | 0) +
-      ((i * 2) | 0);
-
-    var left_sample = HEAP16[offset];
-    var right_sample = HEAP16[(offset + 1) | 0];
+  tick();
+};
 
+// Converts a block of interleaved int16 stereo samples to float channels.
+function deinterleave (samples, left, right, count) {
+  for (var i = 0, j = 0; i < count; i = (i + 1) | 0, j = (j + 2) | 0) {
     // normalize from signed int16 to signed float
-    var left_sample_float = left_sample / sampleScale;
-    var right_sample_float = right_sample / sampleScale;
+    left[i] = samples[j] / sampleScale;
+    right[i] = samples[(j + 1) | 0] / sampleScale;
+  }
+};
+
+// Table-driven polyphase resampler from in_rate to out_rate, for stereo
+// streams fed in blocks of any size.
+//
+// The rate ratio is reduced to out/in = L/M. Every output sample falls on
+// one of L fractional positions between input samples, so the windowed-sinc
+// filter is precomputed once per position (phase) and each output is a
+// plain dot product of `taps` input samples with one table row. The cutoff
+// follows the lower of the two Nyquist rates, so downsampling doesn't alias.
+//
+// 'quality' uses 24 taps per phase, 'fast' uses 6.
+function gcd (a, b) {
+  while (b) {
+    var t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+};
 
-    channel_left[i] = left_sample_float;
-    channel_right[i] = right_sample_float;
+function Resampler (in_rate, out_rate, quality) {
+  var g = gcd(in_rate, out_rate);
+  var L = this.L = out_rate / g;
+  var M = this.M = in_rate / g;
+  var taps = this.taps = (quality === 'fast') ? 6 : 24;
+  var half = taps / 2;
+  var cutoff = Math.min(1, out_rate / in_rate) * ((quality === 'fast') ? 0.9 : 0.95);
+
+  this.table = new Float32Array(L * taps);
+  for (var p = 0; p < L; p++) {
+    var sum = 0;
+    for (var t = 0; t < taps; t++) {
+      // distance from the output position to this tap, in input samples
+      var x = (t - (half - 1)) - p / L;
+      var sinc = (x === 0) ? 1 : Math.sin(Math.PI * cutoff * x) / (Math.PI * cutoff * x);
+      // Blackman window over the filter span
+      var w = 0.42 + 0.5 * Math.cos(Math.PI * x / half) + 0.08 * Math.cos(2 * Math.PI * x / half);
+      var h = (Math.abs(x) >= half) ? 0 : sinc * w;
+      this.table[p * taps + t] = h;
+      sum += h;
+    }
+    // unity gain at DC for every phase
+    for (var t = 0; t < taps; t++)
+      this.table[p * taps + t] /= sum;
   }
 
-  pending_buffers.push(buffer);
+  this.position = 0;   // next output position in input samples * L
+  this.fill = 0;       // input samples kept from the previous block
+  this.buf = [new Float32Array(0), new Float32Array(0)];
+  this.out = [new Float32Array(0), new Float32Array(0)];
+};
 
-  tick();
+// Resamples `count` samples per channel; returns how many output samples are
+// in this.out[0] and this.out[1].
+Resampler.prototype.process = function (left, right, count) {
+  var L = this.L, M = this.M, taps = this.taps, table = this.table;
+  var total = this.fill + count;
+
+  if (this.buf[0].length < total) {
+    for (var c = 0; c < 2; c++) {
+      var grown = new Float32Array(total * 2);
+      grown.set(this.buf[c].subarray(0, this.fill));
+      this.buf[c] = grown;
+    }
+  }
+  this.buf[0].set(left.subarray(0, count), this.fill);
+  this.buf[1].set(right.subarray(0, count), this.fill);
+
+  var max_out = Math.ceil(total * L / M) + 1;
+  if (this.out[0].length < max_out) {
+    this.out[0] = new Float32Array(max_out * 2);
+    this.out[1] = new Float32Array(max_out * 2);
+  }
+
+  var bl = this.buf[0], br = this.buf[1];
+  var ol = this.out[0], or = this.out[1];
+  var position = this.position;
+  var n = 0;
+  for (;;) {
+    var index = (position / L) | 0;
+    if (index + taps > total) break;
+    var row = (position - index * L) * taps;
+    var sl = 0, sr = 0;
+    for (var t = 0; t < taps; t = (t + 1) | 0) {
+      var h = table[row + t];
+      sl += bl[index + t] * h;
+      sr += br[index + t] * h;
+    }
+    ol[n] = sl;
+    or[n] = sr;
+    n = (n + 1) | 0;
+    position += M;
+  }
+
+  // Keep the samples the next outputs still need.
+  var consumed = (position / L) | 0;
+  this.position = position - consumed * L;
+  this.fill = total - consumed;
+  bl.copyWithin(0, consumed, total);
+  br.copyWithin(0, consumed, total);
+  return n;
+};
+
+// Lets MAME mix at `rate` instead of the context rate and resamples here.
+// A lower rate ('fast', e.g. 22050) saves emulator mixing work per sample.
+// Must be called before the emulator starts.
+function set_resampling (rate, quality) {
+  emulatorRate = rate || null;
+  resampleQuality = quality || 'quality';
+  resampler = null;
+};
+
+// Hands every mixed block (heap pointer, stereo sample count) to `fn` too,
+// e.g. for recording; null stops it. The pointer is only valid during the
+// call.
+function set_capture (fn) {
+  capture = fn || null;
+};
+
+// The rate to pass to MAME as -samplerate.
+function get_emulator_rate () {
+  lazy_init();
+  if (!context) return null;
+  return emulatorRate || context.sampleRate;
+};
+
+// Resampler throughput in stereo output samples per second.
+function benchmark_resampler (in_rate, out_rate, quality, seconds) {
+  var r = new Resampler(in_rate || 22050, out_rate || 48000, quality);
+  var count = 735;
+  var left = new Float32Array(count);
+  var right = new Float32Array(count);
+  for (var i = 0; i < count; i++) {
+    left[i] = Math.sin(i / 10);
+    right[i] = Math.cos(i / 13);
+  }
+
+  var clock = (typeof performance !== 'undefined') ? performance : Date;
+  var done = 0;
+  var start = clock.now();
+  var end = start + (seconds || 1) * 1000;
+  while (clock.now() < end) {
+    for (var k = 0; k < 20; k++)
+      done += r.process(left, right, count);
+  }
+  return done / ((clock.now() - start) / 1000);
 };
 
 function tick () {
@@ -136,13 +373,31 @@ function tick () {
   }
 };
 function get_context() {
+  lazy_init();
   return context;
 };
 
+function close() {
+  if (!context) return;
+  context.close();
+  context = null;
+  gain_node = null;
+  buffer_insert_point = null;
+  pending_buffers.length = 0;
+};
+
 return {
   set_mastervolume: set_mastervolume,
   update_audio_stream: update_audio_stream,
-  get_context: get_context
+  get_context: get_context,
+  set_latency_hint: set_latency_hint,
+  get_latency: get_latency,
+  close: close,
+  set_resampling: set_resampling,
+  get_emulator_rate: get_emulator_rate,
+  set_capture: set_capture,
+  benchmark_resampler: benchmark_resampler,
+  Resampler: Resampler
 };
 
 })();
@@ -6,9 +6,17 @@ BENCHTIME=30
 THREADS=4
 PATTERN="*"
 EXECUTABLE=mame
+STARTUP=
+REPEATS=5
+CALIBRATE=
+SOFTLIST=
+SAMPLE=0
+SEED=1
+BARE=
+SPLIT=
 
 shift 2
-while getopts "t:p:x:" opt; do
+while getopts "t:p:x:sr:c:ln:k:bv:" opt; do
 	case "$opt" in
 	t)
 		BENCHTIME=$OPTARG
@@ -19,10 +27,77 @@ while getopts "t:p:x:" opt; do
 	x)
 		EXECUTABLE=$OPTARG
 		;;
+	s)
+		STARTUP=1
+		;;
+	r)
+		REPEATS=$OPTARG
+		;;
+	c)
+		CALIBRATE="-c $OPTARG"
+		;;
+	l)
+		SOFTLIST=1
+		;;
+	n)
+		SAMPLE=$OPTARG
+		;;
+	k)
+		SEED=$OPTARG
+		;;
+	b)
+		BARE=1
+		;;
+	v)
+		SPLIT="-v $OPTARG"
+		;;
 	esac
 done
 
+# Prints the job for a game, or for a system with a software item mounted.
+job() {
+	if [ "$2" != "" ]; then
+		SOFTWARE="-w $2 "
+	else
+		SOFTWARE=
+	fi
+	if [ "$STARTUP" = "1" ]; then
+		echo "./mamebench-startup.sh \"${ROMDIR}\" \"${LOGFILE}\" $1 ${SOFTWARE}-r $REPEATS -x \"${EXECUTABLE}\""
+	else
+		echo "./mamebench-game.sh \"${ROMDIR}\" \"${LOGFILE}\" $1 ${SOFTWARE}-t $BENCHTIME -x \"${EXECUTABLE}\"${CALIBRATE:+ $CALIBRATE}${SPLIT:+ $SPLIT}"
+	fi
+}
+
+# Lists the software items of every software list a system uses that are
+# present in the rom directory (as <list>/<item>.zip, .7z or a directory),
+# sampled down to $SAMPLE items per system with a fixed seed.
+software() {
+	"${EXECUTABLE}" -listsoftware $1 2>/dev/null |
+	awk '
+	/<softwarelist / { match($0, /name="[^"]*"/); list = substr($0, RSTART + 6, RLENGTH - 7) }
+	/<software / { match($0, /name="[^"]*"/); print list "\t" substr($0, RSTART + 6, RLENGTH - 7) }' |
+	sort -u |
+	while IFS="$(printf '\t')" read -r LIST ITEM; do
+		if [ -e "$ROMDIR/$LIST/$ITEM.zip" ] || [ -e "$ROMDIR/$LIST/$ITEM.7z" ] || [ -d "$ROMDIR/$LIST/$ITEM" ]; then
+			echo "$ITEM"
+		fi
+	done |
+	sort -u |
+	awk -v seed=$SEED -v sample=$SAMPLE 'BEGIN { srand(seed) } { print rand() "\t" $0 }' |
+	sort -n |
+	awk -F '\t' -v sample=$SAMPLE 'sample == 0 || NR <= sample { print $2 }'
+}
+
 for I in "$ROMDIR"/$PATTERN.zip; do 
 	GAME=$(basename "${I/\.zip/}")
-	echo "./mamebench-game.sh \"${ROMDIR}\" \"${LOGFILE}\" $GAME -t $BENCHTIME -x \"${EXECUTABLE}\""
+	if [ "$SOFTLIST" = "1" ]; then
+		if [ "$BARE" = "1" ]; then
+			job $GAME
+		fi
+		for ITEM in $(software $GAME); do
+			job $GAME $ITEM
+		done
+		continue
+	fi
+	job $GAME
 done
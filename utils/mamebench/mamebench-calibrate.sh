@@ -0,0 +1,53 @@
+#!/bin/bash
+#
+# Runs a fixed calibration kernel and prints "<score>\t<mhz>".
+#
+# The score is kernel iterations per millisecond, so it tracks the clock the
+# benchmark actually gets, turbo and thermal throttling included. The MHz
+# value is the average frequency across all cores, sampled while the kernel
+# runs, or 0 where cpufreq is not available.
+#
+# With -j <n>, n copies of the kernel run at once and the median score is
+# printed: the clock a benchmark gets when n jobs share the machine.
+#
+
+ITERATIONS=2000000
+JOBS=1
+
+while getopts "j:" opt; do
+	case "$opt" in
+	j)
+		JOBS=$OPTARG
+		;;
+	esac
+done
+
+TMPDIR=$(mktemp -d)
+trap 'rm -rf "$TMPDIR"' EXIT
+
+# Prints the kernel's run time in nanoseconds.
+kernel() {
+	START=$(date +%s%N)
+	awk -v n=$ITERATIONS 'BEGIN { for (i = 0; i < n; i++) x = (x * 31 + i) % 1000003; if (x < 0) print x }'
+	END=$(date +%s%N)
+	echo $(( END - START ))
+}
+
+PIDS=
+for J in $(seq $JOBS); do
+	kernel > "$TMPDIR/ns.$J" &
+	PIDS="$PIDS $!"
+done
+
+# Average core frequency, sampled every 50ms until the kernels finish.
+while kill -0 $PIDS 2>/dev/null; do
+	cat /sys/devices/system/cpu/cpu*/cpufreq/scaling_cur_freq 2>/dev/null | awk '{ s += $1 } END { if (NR) printf "%d\n", s / NR / 1000 }' >> "$TMPDIR/mhz"
+	sleep 0.05
+done
+wait
+
+MHZ=$(awk '{ s += $1 } END { printf "%d", NR ? s / NR : 0 }' "$TMPDIR/mhz" 2>/dev/null || echo 0)
+
+cat "$TMPDIR"/ns.* | sort -n | awk -v n=$ITERATIONS -v mhz=${MHZ:-0} '
+{ ns[NR] = $1 }
+END { printf "%.1f\t%d\n", n / (ns[int((NR + 1) / 2)] / 1000000), mhz }'
@@ -0,0 +1,142 @@
+#!/bin/bash
+#
+# Compares two executables on the same roms.
+#
+# Runs of A and B for the same game are queued next to each other, in ABBA
+# order across repeats, so both see the same machine state instead of one
+# batch running hot and the other cold. Raw results go to <logfile>.a and
+# <logfile>.b; <logfile> gets one line per game:
+#
+#   <game> <fullname> <median A> <median B> <B vs A in %> <samples used A/B>
+#
+# With -c, speeds are normalized to a calibration score taken before the
+# queue starts and throttled samples are left out of the medians.
+#
+
+if [ $# -lt 2 ]; then
+	echo "Usage: $0 <romdir> <logfile> -a <executable> -b <executable> [-t <benchtime>] [-j <processes>] [-p <pattern>] [-r <repeats>] [-c]"
+	exit 1
+fi
+
+ROMDIR=$1
+LOGFILE=$2
+BENCHTIME=30
+PROCESSES=4
+PATTERN="*"
+REPEATS=2
+EXECUTABLEA=
+EXECUTABLEB=
+CALIBRATE=
+
+shift 2
+while getopts "a:b:t:j:p:r:c" opt; do
+	case "$opt" in
+	a)
+		EXECUTABLEA=$OPTARG
+		;;
+	b)
+		EXECUTABLEB=$OPTARG
+		;;
+	t)
+		BENCHTIME=$OPTARG
+		;;
+	j)
+		PROCESSES=$OPTARG
+		;;
+	p)
+		PATTERN=$OPTARG
+		;;
+	r)
+		REPEATS=$OPTARG
+		;;
+	c)
+		CALIBRATE=1
+		;;
+	esac
+done
+
+if [ "$EXECUTABLEA" = "" ] || [ "$EXECUTABLEB" = "" ]; then
+	echo "Both -a and -b executables are required"
+	exit 1
+fi
+
+if [ ! -d "$ROMDIR" ]; then
+	echo "Could not find rom directory: $ROMDIR"
+	exit 1
+fi
+
+# The reference is taken under the same load as the jobs (see mamebench.sh).
+if [ "$CALIBRATE" != "" ]; then
+	REFSCORE=$(./mamebench-calibrate.sh -j $PROCESSES | cut -f 1)
+	echo "Calibration reference score: $REFSCORE"
+	CALIBRATE="-c $REFSCORE"
+fi
+
+NUMROMS=$(ls "${ROMDIR}"/${PATTERN} |wc -l)
+
+echo "Comparing $EXECUTABLEA and $EXECUTABLEB on $NUMROMS roms in $ROMDIR, $REPEATS repeats of $BENCHTIME seconds ($PROCESSES processes)"
+
+for I in "$ROMDIR"/$PATTERN.zip; do
+	GAME=$(basename "${I/\.zip/}")
+	for R in $(seq $REPEATS); do
+		if [ $(( R % 2 )) -eq 1 ]; then
+			ORDER="a b"
+		else
+			ORDER="b a"
+		fi
+		for SIDE in $ORDER; do
+			if [ "$SIDE" = "a" ]; then
+				EXECUTABLE=$EXECUTABLEA
+			else
+				EXECUTABLE=$EXECUTABLEB
+			fi
+			echo "./mamebench-game.sh \"${ROMDIR}\" \"${LOGFILE}.${SIDE}\" $GAME -t $BENCHTIME -x \"${EXECUTABLE}\" $CALIBRATE"
+		done
+	done
+done | ./procspawn.sh $PROCESSES
+
+awk -F '\t' '
+function median(key,   n, i, j, t, s) {
+	n = 0
+	for (i = 1; i <= cnt[key]; i++)
+		s[++n] = val[key, i]
+	for (i = 2; i <= n; i++)
+		for (j = i; j > 1 && s[j - 1] > s[j]; j--) {
+			t = s[j]; s[j] = s[j - 1]; s[j - 1] = t
+		}
+	return (n % 2) ? s[(n + 1) / 2] : (s[n / 2] + s[n / 2 + 1]) / 2
+}
+FNR == 1 { side = (FILENAME ~ /\.a$/) ? "a" : "b" }
+{
+	metric = (NF >= 4) ? $4 : "speed"
+	if (metric == "speed.norm")
+		norm = 1
+	value = $3
+	sub(/%$/, "", value)
+	if (value !~ /^[0-9.]+$/)
+		next
+	games[$1] = $2
+	kind = ($5 ~ /throttled/) ? "throttled" : "ok"
+	key = $1 SUBSEP side SUBSEP metric SUBSEP kind
+	val[key, ++cnt[key]] = value
+}
+END {
+	metric = norm ? "speed.norm" : "speed"
+	for (game in games) {
+		line = game "\t" games[game]
+		used = ""
+		for (s = 1; s <= 2; s++) {
+			side = (s == 1) ? "a" : "b"
+			key = game SUBSEP side SUBSEP metric SUBSEP "ok"
+			if (!cnt[key])
+				key = game SUBSEP side SUBSEP metric SUBSEP "throttled"
+			m[side] = cnt[key] ? median(key) : 0
+			line = line "\t" sprintf("%.2f%%", m[side])
+			used = used (s == 2 ? "/" : "") (cnt[key] + 0) (key ~ /throttled$/ ? "t" : "")
+		}
+		delta = m["a"] ? (m["b"] - m["a"]) / m["a"] * 100 : 0
+		print line "\t" sprintf("%+.2f%%", delta) "\t" used
+	}
+}' "${LOGFILE}.a" "${LOGFILE}.b" | sort > "${LOGFILE}"
+
+echo "Comparison written to $LOGFILE"
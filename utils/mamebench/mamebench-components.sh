@@ -0,0 +1,129 @@
+#!/bin/bash
+#
+# Native vs Node.js CPU comparison: whole systems running software that
+# keeps one CPU core busy, named after that core.
+#
+# Runs every workload in components.lst (or -l <list>) with -bench on the
+# native executable, on the JSMESS engines of a JSMESS checkout under Node.js
+# (mamebench-node.js), or both, and appends the results to <logfile> in
+# mamebench log format as "speed.<component>" with "side=native" or
+# "side=js" in the notes. Both sides use the same -bench measure, so the
+# numbers compare directly; the table on stdout shows the js/native ratio.
+# Every run is the whole system, so the core's share of the profile is only
+# as large as the workload makes it.
+#
+# A workload only runs on the js side if its system has been built in the
+# checkout (build/<subtarget>/<system>/mess*.js).
+#
+
+if [ $# -lt 2 ]; then
+	echo "Usage: $0 <romdir> <logfile> [-x <native executable>] [-j <jsmessdir>] [-l <list>] [-t <benchtime>] [-p <component pattern>]"
+	exit 1
+fi
+
+ROMDIR=$(readlink -f "$1")
+LOGFILE=$(readlink -f "$2")
+EXECUTABLE=
+JSMESSDIR=
+LIST=$(cd "$(dirname "$0")" && pwd)/components.lst
+BENCHTIME=30
+PATTERN="*"
+
+shift 2
+while getopts "x:j:l:t:p:" opt; do
+	case "$opt" in
+	x)
+		EXECUTABLE=$OPTARG
+		;;
+	j)
+		JSMESSDIR=$(readlink -f "$OPTARG")
+		;;
+	l)
+		LIST=$(readlink -f "$OPTARG")
+		;;
+	t)
+		BENCHTIME=$OPTARG
+		;;
+	p)
+		PATTERN=$OPTARG
+		;;
+	esac
+done
+
+if [ "$EXECUTABLE" = "" ] && [ "$JSMESSDIR" = "" ]; then
+	echo "A native executable (-x), a JSMESS checkout (-j) or both are required"
+	exit 1
+fi
+
+# Paths are resolved before moving to the scripts' directory; an executable
+# without a slash is looked up in PATH.
+case "$EXECUTABLE" in
+*/*)
+	EXECUTABLE=$(readlink -f "$EXECUTABLE")
+	;;
+esac
+
+cd "$(dirname "$0")"
+
+TMPDIR=$(mktemp -d)
+trap 'rm -rf "$TMPDIR"' EXIT
+
+# Appends one side's result for a workload, renamed to its component.
+run() {
+	COMPONENT=$1
+	SYSTEM=$2
+	ITEM=$3
+	SIDE=$4
+	EXE=$5
+	rm -f "$TMPDIR/out"
+	./mamebench-game.sh "$ROMDIR" "$TMPDIR/out" $SYSTEM ${ITEM:+-w $ITEM} -t $BENCHTIME -x "$EXE"
+	awk -F '\t' -v component=$COMPONENT -v side=$SIDE '{
+		printf "%s\t%s\t%s\tspeed.%s\tside=%s\n", $1, $2, $3, component, side
+	}' "$TMPDIR/out" >> "$LOGFILE"
+}
+
+touch "$LOGFILE"
+SKIP=$(wc -l < "$LOGFILE")
+
+grep -v '^#' "$LIST" | grep -v '^$' | while IFS="$(printf '\t')" read -r COMPONENT SYSTEM ITEM; do
+	case "$COMPONENT" in
+	$PATTERN)
+		;;
+	*)
+		continue
+		;;
+	esac
+	echo "Benchmarking $COMPONENT ($SYSTEM${ITEM:+:$ITEM})"
+	if [ "$EXECUTABLE" != "" ]; then
+		run $COMPONENT $SYSTEM "$ITEM" native "$EXECUTABLE"
+	fi
+	if [ "$JSMESSDIR" != "" ]; then
+		ENGINE=$(ls "$JSMESSDIR"/build/*/$SYSTEM/mess*.js 2>/dev/null | head -1)
+		if [ "$ENGINE" = "" ]; then
+			echo "No JSMESS build of $SYSTEM in $JSMESSDIR, skipping the js side"
+			continue
+		fi
+		JSMESS_ENGINE="$ENGINE" run $COMPONENT $SYSTEM "$ITEM" js "$(pwd)/mamebench-node.js"
+	fi
+done
+
+# <component> <native speed> <js speed> <js/native>
+printf 'component\tnative\tjs\tjs/native\n'
+tail -n +$((SKIP + 1)) "$LOGFILE" | awk -F '\t' '
+$4 ~ /^speed\./ {
+	c = substr($4, 7)
+	if (!(c in seen)) { seen[c] = 1; order[++n] = c }
+	v = $3
+	sub(/%$/, "", v)
+	if ($5 == "side=native") native[c] = v
+	if ($5 == "side=js") js[c] = v
+}
+END {
+	for (i = 1; i <= n; i++) {
+		c = order[i]
+		n_s = (c in native) ? native[c] "%" : "-"
+		j_s = (c in js) ? js[c] "%" : "-"
+		ratio = ((c in native) && (c in js) && native[c] > 0) ? sprintf("%.2f", js[c] / native[c]) : "-"
+		printf "%s\t%s\t%s\t%s\n", c, n_s, j_s, ratio
+	}
+}'
@@ -0,0 +1,259 @@
+#!/bin/bash
+#
+# Historical benchmark result store.
+#
+# Keeps every mamebench run in a single SQLite file, together with the
+# executable version, flags and host it ran on, and finds sustained per-game
+# changes across runs.
+#
+# Requires `sqlite3` in your path.
+#
+
+if [ $# -lt 2 ]; then
+	echo "Usage: $0 <dbfile> init"
+	echo "       $0 <dbfile> ingest <logfile> [-x <executable>] [-f <flags>] [-n <note>]"
+	echo "       $0 <dbfile> changes [-m <minrun>] [-s <minshift>] [-z <minscore>]"
+	echo "       $0 <dbfile> when <game> [-M <metric>]"
+	exit 1
+fi
+
+hash sqlite3 2>/dev/null || { echo >&2 "'sqlite3' required, not found."; exit 1; }
+
+DBFILE=$1
+COMMAND=$2
+TAB=$(printf '\t')
+
+shift 2
+
+# Quotes a string for use as an SQL literal.
+sqlquote() {
+	printf "'%s'" "$(printf '%s' "$1" | sed "s/'/''/g")"
+}
+
+dbinit() {
+	sqlite3 "$DBFILE" <<EOF
+CREATE TABLE IF NOT EXISTS runs (
+	id INTEGER PRIMARY KEY,
+	rundate TEXT NOT NULL,
+	ingested TEXT NOT NULL,
+	logfile TEXT,
+	executable TEXT,
+	version TEXT,
+	flags TEXT,
+	host TEXT,
+	cpu TEXT,
+	kernel TEXT,
+	note TEXT
+);
+CREATE TABLE IF NOT EXISTS results (
+	run_id INTEGER NOT NULL REFERENCES runs(id),
+	game TEXT NOT NULL,
+	fullname TEXT,
+	metric TEXT NOT NULL DEFAULT 'speed',
+	value REAL,
+	notes TEXT
+);
+CREATE INDEX IF NOT EXISTS results_game ON results(game, metric);
+CREATE TABLE IF NOT EXISTS changes (
+	game TEXT NOT NULL,
+	metric TEXT NOT NULL,
+	run_id INTEGER NOT NULL REFERENCES runs(id),
+	before REAL,
+	after REAL,
+	shift REAL,
+	score REAL,
+	slower INTEGER,
+	PRIMARY KEY (game, metric, run_id)
+);
+CREATE VIEW IF NOT EXISTS history AS
+	SELECT results.game, results.fullname, results.metric, results.value,
+	       results.notes, runs.id AS run_id, runs.rundate, runs.version,
+	       runs.flags, runs.host, runs.cpu
+	FROM results JOIN runs ON runs.id = results.run_id;
+CREATE VIEW IF NOT EXISTS slowdowns AS
+	SELECT changes.game, changes.metric, runs.rundate, runs.version,
+	       runs.flags, runs.host, changes.before, changes.after,
+	       changes.shift, changes.score
+	FROM changes JOIN runs ON runs.id = changes.run_id
+	WHERE changes.slower = 1;
+EOF
+}
+
+# Finds sustained level shifts in every (game, metric) series by binary
+# segmentation: split where the two-sample t score is highest, keep the split
+# if both sides have at least MINRUN runs and the means differ by at least
+# MINSHIFT percent, then recurse into both halves. Samples flagged as
+# throttled by calibrated runs are left out.
+dbchanges() {
+	MINRUN=3
+	MINSHIFT=3
+	MINSCORE=5
+	OPTIND=1
+	while getopts "m:s:z:" opt; do
+		case "$opt" in
+		m)
+			MINRUN=$OPTARG
+			;;
+		s)
+			MINSHIFT=$OPTARG
+			;;
+		z)
+			MINSCORE=$OPTARG
+			;;
+		esac
+	done
+
+	sqlite3 -separator "$TAB" "$DBFILE" \
+		"SELECT game, metric, run_id, value FROM history WHERE value IS NOT NULL AND coalesce(notes, '') NOT LIKE '%throttled%' ORDER BY game, metric, rundate, run_id;" |
+	awk -F '\t' -v minrun=$MINRUN -v minshift=$MINSHIFT -v minscore=$MINSCORE '
+	function sq(s) { gsub(/\047/, "\047\047", s); return "\047" s "\047" }
+	function detect(   sp, lo, hi, k, nl, nr, ml, mr, sse, se, t, best, bestk, shift) {
+		if (n < 2 * minrun)
+			return
+		P[0] = 0; Q[0] = 0
+		for (k = 1; k <= n; k++) {
+			P[k] = P[k - 1] + v[k]
+			Q[k] = Q[k - 1] + v[k] * v[k]
+		}
+		sp = 1; stlo[1] = 1; sthi[1] = n
+		while (sp > 0) {
+			lo = stlo[sp]; hi = sthi[sp]; sp--
+			best = 0; bestk = 0
+			# k is the first run after the change
+			for (k = lo + minrun; k <= hi - minrun + 1; k++) {
+				nl = k - lo; nr = hi - k + 1
+				ml = (P[k - 1] - P[lo - 1]) / nl
+				mr = (P[hi] - P[k - 1]) / nr
+				sse = (Q[k - 1] - Q[lo - 1]) - nl * ml * ml + (Q[hi] - Q[k - 1]) - nr * mr * mr
+				if (sse < 0)
+					sse = 0
+				se = (nl + nr > 2) ? sqrt(sse / (nl + nr - 2) * (1 / nl + 1 / nr)) : 0
+				t = (se > 0) ? (mr - ml) / se : (mr != ml ? 1e9 : 0)
+				if (t < 0)
+					t = -t
+				if (t > best) {
+					best = t; bestk = k; bml = ml; bmr = mr
+				}
+			}
+			if (bestk == 0 || best < minscore || bml == 0)
+				continue
+			shift = (bmr - bml) / bml * 100
+			if ((shift < 0 ? -shift : shift) < minshift)
+				continue
+			# speed is better when higher, everything else (times, costs) when lower
+			slower = (metric ~ /^speed/) ? (shift < 0) : (shift > 0)
+			printf "INSERT INTO changes VALUES (%s, %s, %d, %f, %f, %f, %f, %d);\n", sq(game), sq(metric), id[bestk], bml, bmr, shift, best, slower
+			stlo[++sp] = lo; sthi[sp] = bestk - 1
+			stlo[++sp] = bestk; sthi[sp] = hi
+		}
+	}
+	BEGIN { print "BEGIN TRANSACTION;"; print "DELETE FROM changes;" }
+	$1 != game || $2 != metric { detect(); game = $1; metric = $2; n = 0 }
+	{ n++; id[n] = $3; v[n] = $4 + 0 }
+	END { detect(); print "COMMIT;" }
+	' | sqlite3 "$DBFILE"
+
+	sqlite3 -separator "$TAB" "$DBFILE" "SELECT count(*), coalesce(sum(slower), 0) FROM changes;" |
+		awk -F '\t' '{ print "Found " $1 " sustained changes (" $2 " slowdowns)" }'
+}
+
+dbingest() {
+	LOGFILE=$1
+	EXECUTABLE=mame
+	FLAGS=
+	NOTE=
+	shift
+	while getopts "x:f:n:" opt; do
+		case "$opt" in
+		x)
+			EXECUTABLE=$OPTARG
+			;;
+		f)
+			FLAGS=$OPTARG
+			;;
+		n)
+			NOTE=$OPTARG
+			;;
+		esac
+	done
+
+	if [ ! -f "$LOGFILE" ]; then
+		echo "Could not find log file: $LOGFILE"
+		exit 1
+	fi
+
+	# benchmark-YYYYMMDD.tsv names carry the run date; otherwise use the mtime.
+	RUNDATE=$(basename "$LOGFILE" | sed -n 's/.*\([0-9]\{4\}\)\([0-9]\{2\}\)\([0-9]\{2\}\).*/\1-\2-\3/p')
+	if [ "$RUNDATE" = "" ]; then
+		RUNDATE=$(date -r "$LOGFILE" +%Y-%m-%d)
+	fi
+	VERSION=$("${EXECUTABLE}" -help 2>/dev/null | head -1)
+	HOST=$(uname -n)
+	KERNEL=$(uname -srm)
+	CPU=$(grep -m 1 "^model name" /proc/cpuinfo 2>/dev/null | sed 's/.*: //')
+
+	dbinit
+
+	{
+		echo "BEGIN TRANSACTION;"
+		echo "INSERT INTO runs (rundate, ingested, logfile, executable, version, flags, host, cpu, kernel, note) VALUES (" \
+			"$(sqlquote "$RUNDATE"), datetime('now'), $(sqlquote "$LOGFILE"), $(sqlquote "$EXECUTABLE")," \
+			"$(sqlquote "$VERSION"), $(sqlquote "$FLAGS"), $(sqlquote "$HOST"), $(sqlquote "$CPU")," \
+			"$(sqlquote "$KERNEL"), $(sqlquote "$NOTE"));"
+		# <game> <fullname> <value>[%] [<metric> [<notes>]]
+		awk -F '\t' '
+		function sq(s) { gsub(/\047/, "\047\047", s); return "\047" s "\047" }
+		NF >= 3 {
+			value = $3
+			sub(/%$/, "", value)
+			if (value !~ /^[0-9.]+$/)
+				value = "NULL"
+			metric = (NF >= 4 && $4 != "") ? $4 : "speed"
+			printf "INSERT INTO results VALUES ((SELECT max(id) FROM runs), %s, %s, %s, %s, %s);\n", sq($1), sq($2), sq(metric), value, (NF >= 5) ? sq($5) : "NULL"
+		}' "$LOGFILE"
+		echo "COMMIT;"
+	} | sqlite3 "$DBFILE" || exit 1
+
+	sqlite3 -separator "$TAB" "$DBFILE" "SELECT count(*) FROM results WHERE run_id = (SELECT max(id) FROM runs);" |
+		awk '{ print "Ingested " $1 " results from '"$LOGFILE"'" }'
+
+	dbchanges
+}
+
+dbwhen() {
+	GAME=$1
+	METRIC=
+	shift
+	while getopts "M:" opt; do
+		case "$opt" in
+		M)
+			METRIC=$OPTARG
+			;;
+		esac
+	done
+
+	WHERE="game = $(sqlquote "$GAME")"
+	if [ "$METRIC" != "" ]; then
+		WHERE="$WHERE AND metric = $(sqlquote "$METRIC")"
+	fi
+	sqlite3 -header -column "$DBFILE" "SELECT * FROM slowdowns WHERE $WHERE ORDER BY rundate;"
+}
+
+case "$COMMAND" in
+init)
+	dbinit
+	;;
+ingest)
+	dbingest "$@"
+	;;
+changes)
+	dbchanges "$@"
+	;;
+when)
+	dbwhen "$@"
+	;;
+*)
+	echo "Unknown command: $COMMAND"
+	exit 1
+	;;
+esac
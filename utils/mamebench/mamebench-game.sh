@@ -6,9 +6,12 @@ GAME=$3
 
 BENCHTIME=30
 EXECUTABLE=mame
+REFSCORE=
+SOFTWARE=
+SPLIT=
 
 shift 3
-while getopts "t:x:" opt; do
+while getopts "t:x:c:w:v:" opt; do
 	case "$opt" in
 	t)
 		BENCHTIME=$OPTARG
@@ -16,10 +19,120 @@ while getopts "t:x:" opt; do
 	x)
 		EXECUTABLE=$OPTARG
 		;;
+	c)
+		REFSCORE=$OPTARG
+		;;
+	w)
+		SOFTWARE=$OPTARG
+		;;
+	v)
+		SPLIT=$OPTARG
+		;;
 	esac
 done
 
-MAMEOUT=$(SDLMAME_DESKTOPDIM=800x600 SDL_VIDEODRIVER=dummy SDL_RENDER_DRIVER=software "${EXECUTABLE}" -rompath "$ROMDIR" -bench $BENCHTIME $GAME | tr -d '\n' | sed 's/.*Average speed: //' | sed 's/\% .*$/%/' )
+# Runs the game with the given SDL video driver and MAME options and prints
+# the average speed.
+bench() {
+	DRIVER=$1
+	shift
+	SDLMAME_DESKTOPDIM=800x600 SDL_VIDEODRIVER=$DRIVER SDL_RENDER_DRIVER=software "${EXECUTABLE}" -rompath "$ROMDIR" "$@" $GAME $SOFTWARE | tr -d '\n' | sed 's/.*Average speed: //' | sed 's/\% .*$/%/'
+}
+
+# Calibrated runs log the raw speed and the speed scaled to the reference
+# calibration score, and flag the sample as throttled if the machine was
+# more than 5% slower than the reference, or drifted by more than 5% during
+# the run. Prints the notes and the scale factor, tab separated.
+calibration() {
+	AFTER=$(./mamebench-calibrate.sh)
+	printf '%s\t%s\n' "$BEFORE" "$AFTER" | awk -F '\t' -v ref=$REFSCORE '{
+		score = ($1 + $3) / 2
+		notes = sprintf("calib=%s/%s;ref=%s;mhz=%s/%s", $1, $3, ref, $2, $4)
+		if (score < ref * 0.95 || $3 < $1 * 0.95 || $1 < $3 * 0.95)
+			notes = notes ";throttled"
+		printf "%s\t%f\n", notes, ref / score
+	}'
+}
+
+if [ "$REFSCORE" != "" ]; then
+	BEFORE=$(./mamebench-calibrate.sh)
+fi
+
+MAMEOUT=$(bench dummy -bench $BENCHTIME)
+
+# Split mode (-v <SDL video driver>) times the same game three ways:
+#   -bench (no OSD video)                      emulation, drivers' own drawing
+#   -video soft on the dummy driver            + OSD render and compose
+#   -video soft on the given driver            + presentation to a window
+# and logs "speed.emu", "speed.render" and "speed.present" with the cost of
+# each added stage in ms per emulated second ("cost.render", "cost.present").
+# "-v dummy" skips the presentation pass, e.g. without a display. With -c,
+# the calibration covers all three passes and each speed also gets a
+# ".norm" line.
+if [ "$SPLIT" != "" ]; then
+	RENDER=$(bench dummy -str $BENCHTIME -nothrottle -sound none -video soft)
+	PRESENT=
+	if [ "$SPLIT" != "dummy" ]; then
+		PRESENT=$(bench $SPLIT -str $BENCHTIME -nothrottle -sound none -video soft)
+	fi
+fi
 FULLNAME=$("${EXECUTABLE}" -listfull $GAME |tail -1 |sed -r 's/^.*"(.*)"$/\1/g')
-echo "$GAME\t$FULLNAME\t$MAMEOUT" >> "${LOGFILE}"
 
+# Software items are logged as <system>:<item>, "<system> / <description>".
+if [ "$SOFTWARE" != "" ]; then
+	DESCRIPTION=$("${EXECUTABLE}" -listsoftware $GAME | awk -v item="$SOFTWARE" '
+		index($0, "<software name=\"" item "\"") { found = 1 }
+		found && /<description>/ { sub(/.*<description>/, ""); sub(/<\/description>.*/, ""); print; exit }')
+	FULLNAME="$FULLNAME / $DESCRIPTION"
+	GAME="$GAME:$SOFTWARE"
+fi
+
+if [ "$SPLIT" != "" ]; then
+	CALIB=
+	if [ "$REFSCORE" != "" ]; then
+		CALIB=$(calibration)
+	fi
+	awk -v game="$GAME" -v fullname="$FULLNAME" -v emu="$MAMEOUT" -v render="$RENDER" -v present="$PRESENT" -v driver=$SPLIT -v calib="$CALIB" '
+	function speed(metric, value, notes) {
+		printf "%s\t%s\t%.2f%%\t%s\t%s%s\n", game, fullname, value, metric, notes, calibnotes
+		if (norm)
+			printf "%s\t%s\t%.2f%%\t%s.norm\t%s%s\n", game, fullname, value * norm, metric, notes, calibnotes
+	}
+	BEGIN {
+		sub(/%$/, "", emu); sub(/%$/, "", render); sub(/%$/, "", present)
+		calibnotes = ""; norm = 0
+		if (split(calib, c, "\t") == 2) {
+			calibnotes = ";" c[1]; norm = c[2]
+		}
+		if (emu !~ /^[0-9.]+$/ || emu == 0) {
+			printf "%s\t%s\t%s\tspeed.emu\tsplit%s\n", game, fullname, emu, calibnotes
+			exit
+		}
+		speed("speed.emu", emu, "split")
+		if (render !~ /^[0-9.]+$/ || render == 0)
+			exit
+		speed("speed.render", render, "split;video=soft")
+		printf "%s\t%s\t%.2f\tcost.render\tsplit;video=soft%s\n", game, fullname, 100000 / render - 100000 / emu, calibnotes
+		if (present !~ /^[0-9.]+$/ || present == 0)
+			exit
+		speed("speed.present", present, "split;video=soft;driver=" driver)
+		printf "%s\t%s\t%.2f\tcost.present\tsplit;video=soft;driver=%s%s\n", game, fullname, 100000 / present - 100000 / render, driver, calibnotes
+	}' >> "${LOGFILE}"
+	exit 0
+fi
+
+if [ "$REFSCORE" = "" ]; then
+	echo "$GAME\t$FULLNAME\t$MAMEOUT" >> "${LOGFILE}"
+	exit 0
+fi
+
+calibration | awk -F '\t' -v game="$GAME" -v fullname="$FULLNAME" -v speed="$MAMEOUT" '{
+	notes = $1
+	sub(/%$/, "", speed)
+	if (speed !~ /^[0-9.]+$/) {
+		printf "%s\t%s\t%s\tspeed\t%s\n", game, fullname, speed, notes
+		exit
+	}
+	printf "%s\t%s\t%.2f%%\tspeed\t%s\n", game, fullname, speed, notes
+	printf "%s\t%s\t%.2f%%\tspeed.norm\t%s\n", game, fullname, speed * $2, notes
+}' >> "${LOGFILE}"
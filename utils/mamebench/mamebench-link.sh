@@ -0,0 +1,62 @@
+#!/bin/bash
+#
+# Times the final emcc link step of JSMESS builds.
+#
+# Relinks every system once per core count (EMCC_CORES, which emcc reads
+# from the environment) and appends the times to <logfile> in mamebench log
+# format, metric "build.link" in seconds with the core count in the notes,
+# then prints a table per system. The systems must have been built once
+# already.
+#
+
+if [ $# -lt 3 ]; then
+	echo "Usage: $0 <jsmessdir> <logfile> <system>... [-c <core counts>]"
+	exit 1
+fi
+
+JSMESSDIR=$1
+LOGFILE=$(readlink -f "$2")
+shift 2
+
+SYSTEMS=
+while [ $# -gt 0 ] && [ "${1#-}" = "$1" ]; do
+	SYSTEMS="$SYSTEMS $1"
+	shift
+done
+
+CORES="1 $(nproc)"
+
+while getopts "c:" opt; do
+	case "$opt" in
+	c)
+		CORES=$OPTARG
+		;;
+	esac
+done
+
+# Only this invocation's lines go into the table.
+touch "$LOGFILE"
+SKIP=$(wc -l < "$LOGFILE")
+
+for SYSTEM in $SYSTEMS; do
+	for N in $CORES; do
+		echo "Relinking $SYSTEM on $N cores"
+		EMCC_CORES=$N make -C "$JSMESSDIR" SYSTEM=$SYSTEM LINK_LOG="$LOGFILE" relink >/dev/null || exit 1
+	done
+done
+
+# <system> <seconds on each core count> <speedup of the last over the first>
+awk -F '\t' '
+$4 == "build.link" {
+	split($5, notes, ";")
+	sub(/^cores=/, "", notes[1])
+	if (!($1 in first)) { first[$1] = $3; order[++n] = $1 }
+	times[$1] = times[$1] "\t" notes[1] ": " $3 "s"
+	last[$1] = $3
+}
+END {
+	for (i = 1; i <= n; i++) {
+		s = order[i]
+		printf "%s%s\t%.2fx\n", s, times[s], (last[s] > 0) ? first[s] / last[s] : 0
+	}
+}' <(tail -n +$((SKIP + 1)) "$LOGFILE")
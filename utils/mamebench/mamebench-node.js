@@ -0,0 +1,156 @@
+#!/usr/bin/env node
+//
+// Runs a JSMESS engine under Node.js with MAME's command line, so the
+// mamebench scripts can benchmark browser builds the way they benchmark
+// native ones:
+//
+//   JSMESS_ENGINE=build/mess_coleco/coleco/messmess_coleco.js \
+//       ./mamebench-game.sh /data/roms coleco.tsv coleco -x ./mamebench-node.js
+//
+// -rompath is mounted into the engine's filesystem. -bench <seconds> runs
+// that many emulated seconds with video and sound off, as MAME does, driving
+// the main loop directly instead of on timers, and prints MAME's "Average
+// speed" line. Anything else (-listfull, -listxml, ...) runs as is.
+//
+
+var fs = require('fs');
+var path = require('path');
+var vm = require('vm');
+
+var engine = process.env.JSMESS_ENGINE;
+if (!engine || !fs.existsSync(engine)) {
+	console.error('Set JSMESS_ENGINE to the engine .js of a JSMESS build');
+	process.exit(1);
+}
+engine = path.resolve(engine);
+
+var args = process.argv.slice(2);
+var bench = 0;
+var rompath = null;
+var mame_args = [];
+for (var i = 0; i < args.length; i++) {
+	if (args[i] === '-bench') {
+		bench = parseFloat(args[++i]);
+	} else if (args[i] === '-rompath') {
+		rompath = path.resolve(args[++i].split(';')[0]);
+	} else {
+		mame_args.push(args[i]);
+	}
+}
+if (rompath) {
+	mame_args.push('-rompath', '/roms');
+}
+if (bench > 0) {
+	mame_args.push('-video', 'none', '-sound', 'none', '-nothrottle');
+}
+
+// Copies a directory tree into MEMFS.
+function copy_tree (from, to) {
+	FS.mkdir(to);
+	fs.readdirSync(from).forEach(function (name) {
+		var source = path.join(from, name);
+		if (fs.statSync(source).isDirectory()) {
+			copy_tree(source, to + '/' + name);
+		} else {
+			FS.writeFile(to + '/' + name, new Uint8Array(fs.readFileSync(source)), { encoding: 'binary' });
+		}
+	});
+}
+
+// For engines linked without NODEFS: copies what MAME will look for of the
+// system and software item named on the command line, rather than the whole
+// rompath. That is <name>.zip, .7z or an unzipped <name>/ at the top and in
+// the software list directories under it; a software list directory named
+// like the system holds both. Parents, BIOSes and devices kept in other
+// archives are not found; use an engine with NODEFS for those.
+function copy_roms (from, to, names) {
+	var wanted = function (name) {
+		return names.hasOwnProperty(name.replace(/\.(zip|7z)$/, ''));
+	};
+	var copy = function (source, target) {
+		if (fs.statSync(source).isDirectory()) {
+			copy_tree(source, target);
+		} else {
+			FS.writeFile(target, new Uint8Array(fs.readFileSync(source)), { encoding: 'binary' });
+		}
+	};
+	FS.mkdir(to);
+	fs.readdirSync(from).forEach(function (name) {
+		var source = path.join(from, name);
+		if (!fs.statSync(source).isDirectory()) {
+			if (wanted(name)) copy(source, to + '/' + name);
+			return;
+		}
+		FS.mkdir(to + '/' + name);
+		fs.readdirSync(source).forEach(function (entry) {
+			var item = path.join(source, entry);
+			// Items of the list, or the loose ROM files of an unzipped system.
+			var rom = wanted(name) && !/\.(zip|7z)$/.test(entry) && !fs.statSync(item).isDirectory();
+			if (rom || wanted(entry)) copy(item, to + '/' + name + '/' + entry);
+		});
+	});
+}
+
+function now () {
+	var t = process.hrtime();
+	return t[0] * 1000 + t[1] / 1e6;
+}
+
+// Runs the emulated seconds back to back, then reports like MAME's -bench.
+function run_bench () {
+	Module['preMainLoop'] = function () { return false; };
+	var frames = Math.round(bench * 60);
+	var start = now();
+	for (var n = 0; n < frames; n++) {
+		JSMESS.run_frame();
+	}
+	var seconds = (now() - start) / 1000;
+	console.log('Average speed: ' + (bench / seconds * 100).toFixed(2) + '% (' + bench + ' seconds)');
+	process.exit(0);
+}
+
+// What the page normally provides: the ready queue pre.js uses and the web
+// audio entry points.
+global.JSMESS = {
+	running: false,
+	ready: function (callback) {
+		var check = function () {
+			if (JSMESS.running) {
+				callback();
+			} else {
+				setTimeout(check, 10);
+			}
+		};
+		check();
+	}
+};
+global.jsmess_set_mastervolume = function () {};
+global.jsmess_update_audio_stream = function () {};
+
+global.Module = {
+	'arguments': mame_args,
+	'print': function (text) { console.log(text); },
+	'printErr': function (text) { console.error(text); },
+	'memoryInitializerPrefixURL': path.dirname(engine) + '/',
+	'preRun': [function () {
+		if (!rompath) return;
+		if (typeof NODEFS !== 'undefined') {
+			FS.mkdir('/roms');
+			FS.mount(NODEFS, { root: rompath }, '/roms');
+		} else {
+			var names = {};
+			mame_args.forEach(function (arg) {
+				if (arg.charAt(0) !== '-') {
+					arg.split(':').forEach(function (part) { names[part] = true; });
+				}
+			});
+			copy_roms(rompath, '/roms', names);
+		}
+	}]
+};
+if (bench > 0) {
+	JSMESS.ready(run_bench);
+}
+
+global.require = require;
+vm.runInThisContext(fs.readFileSync(engine, 'utf8'), { filename: engine });
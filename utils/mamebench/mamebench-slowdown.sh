@@ -0,0 +1,167 @@
+#!/bin/bash
+#
+# Per-function slowdown of the browser build against the native build.
+#
+# Profiles a native executable with `perf` on -bench and joins the result by
+# function with a profile of the browser build running the same workload,
+# taken in the browser console with the same software item loaded:
+#
+#   JSMESS.profiler.bench(<benchtime>)
+#
+# which profiles JSMESS.benchmark over the same emulated seconds and
+# downloads the folded stacks. Both sides are scaled to milliseconds per
+# emulated second.
+#
+# Time the browser spends in JS-only helpers (64-bit math, exception
+# handling through invoke_*, calls from JS into function tables) is charged
+# to the nearest C++ caller in the "helpers" column and also summed per kind
+# on stdout, so those pathologies stand out. <outfile> gets one line per
+# function, most excess time first:
+#
+#   <function> <native ms> <js ms> <js helpers ms> <js/native> <main helper kind>
+#
+# Build both sides with names kept:
+#   make SYSTEM=<system> PROFILE=1                  (browser)
+#   make SYSTEM=<system> PROFILE=1 NATIVE_DEBUG=1 native
+#
+# Requires `perf` in your path.
+#
+
+if [ $# -lt 3 ]; then
+	echo "Usage: $0 <romdir> <outfile> <game> -x <native executable> -f <js folded stacks> [-i <js sample interval ms>] [-t <benchtime>] [-w <software>]"
+	exit 1
+fi
+
+hash perf 2>/dev/null || { echo >&2 "'perf' required, not found."; exit 1; }
+
+ROMDIR=$1
+OUTFILE=$2
+GAME=$3
+EXECUTABLE=
+FOLDED=
+INTERVAL=1
+BENCHTIME=30
+SOFTWARE=
+
+shift 3
+while getopts "x:f:i:t:w:" opt; do
+	case "$opt" in
+	x)
+		EXECUTABLE=$OPTARG
+		;;
+	f)
+		FOLDED=$OPTARG
+		;;
+	i)
+		INTERVAL=$OPTARG
+		;;
+	t)
+		BENCHTIME=$OPTARG
+		;;
+	w)
+		SOFTWARE=$OPTARG
+		;;
+	esac
+done
+
+if [ "$EXECUTABLE" = "" ] || [ ! -f "$FOLDED" ]; then
+	echo "A native executable (-x) and the browser's folded stacks from JSMESS.profiler.bench($BENCHTIME) (-f) are required"
+	exit 1
+fi
+
+TMPDIR=$(mktemp -d)
+trap 'rm -rf "$TMPDIR"' EXIT
+
+# cpu-clock samples carry their period in nanoseconds.
+SDLMAME_DESKTOPDIM=800x600 SDL_VIDEODRIVER=dummy SDL_RENDER_DRIVER=software \
+	perf record -q -e cpu-clock -F 999 -o "$TMPDIR/perf.data" -- \
+	"${EXECUTABLE}" -rompath "$ROMDIR" $GAME $SOFTWARE -bench $BENCHTIME >/dev/null 2>&1 || {
+	echo "perf record failed (check /proc/sys/kernel/perf_event_paranoid)"
+	exit 1
+}
+perf report -i "$TMPDIR/perf.data" --stdio -q --no-children -g none --sort sym -F period,sym 2>/dev/null |
+	awk -v seconds=$BENCHTIME '
+	$1 ~ /^[0-9]+$/ {
+		period = $1
+		$1 = ""; $2 = ""
+		sub(/^ +/, "")
+		printf "%s\t%f\n", $0, period / 1e6 / seconds
+	}' > "$TMPDIR/native"
+
+# Names are matched without parameter lists, compiler clone suffixes or the
+# leading underscore emscripten gives C symbols.
+awk -F '\t' -v interval=$INTERVAL -v emulated=$BENCHTIME -v nativefile="$TMPDIR/native" -v summary="$TMPDIR/summary" '
+function key(name) {
+	sub(/ \[clone [^]]*\]/, "", name)
+	sub(/\(.*$/, "", name)
+	sub(/\.(part|isra|constprop|cold|lto_priv)\.[0-9].*$/, "", name)
+	if (name !~ /::/)
+		sub(/^_/, "", name)
+	return name
+}
+function helper(name) {
+	if (name ~ /^_?(i64Add|i64Subtract|i64Math|bitshift64|llvm_(ctlz|cttz|bswap)_i64|___(u?div|u?mod|mul|udivmod)(d|s)i[34]|___muldsi3)/)
+		return "64-bit math"
+	if (name ~ /^_?invoke_|^___cxa_|^___resumeException|^___gxx_personality|^_?setThrew/)
+		return "exceptions"
+	if (name ~ /^_?dynCall_|^ftCall_/)
+		return "indirect calls"
+	return ""
+}
+BEGIN {
+	while ((getline line < nativefile) > 0) {
+		split(line, f, "\t")
+		native[key(f[1])] += f[2]
+	}
+	scale = interval / emulated
+}
+{
+	# "root;caller;...;leaf count"
+	n = split($0, parts, " ")
+	count = parts[n]
+	stack = substr($0, 1, length($0) - length(count) - 1)
+	depth = split(stack, frames, ";")
+	ms = count * scale
+	total += ms
+	kind = helper(frames[depth])
+	if (kind == "") {
+		js[key(frames[depth])] += ms
+		next
+	}
+	kinds[kind] += ms
+	for (i = depth - 1; i >= 1; i--) {
+		if (helper(frames[i]) == "" && key(frames[i]) in native) {
+			name = key(frames[i])
+			helpers[name] += ms
+			bykind[name, kind] += ms
+			next
+		}
+	}
+	js["(" kind ")"] += ms
+}
+END {
+	for (name in native) seen[name] = 1
+	for (name in js) seen[name] = 1
+	for (name in helpers) seen[name] = 1
+	for (name in seen) {
+		jsall = js[name] + helpers[name]
+		main = "-"; best = 0
+		for (kind in kinds) {
+			if (bykind[name, kind] > best) { best = bykind[name, kind]; main = kind }
+		}
+		ratio = (native[name] > 0) ? sprintf("%.2f", jsall / native[name]) : "-"
+		printf "%f\t%s\t%.3f\t%.3f\t%.3f\t%s\t%s\n", jsall - native[name], name, native[name], js[name], helpers[name], ratio, main
+		nativetotal += native[name]
+	}
+	printf "native\t%.1f ms per emulated second\n", nativetotal > summary
+	printf "js\t%.1f ms per emulated second\n", total > summary
+	for (kind in kinds)
+		printf "js %s\t%.1f ms per emulated second\n", kind, kinds[kind] > summary
+}' "$FOLDED" | sort -t "$(printf '\t')" -k1,1 -g -r | cut -f 2- > "$TMPDIR/report"
+
+{
+	printf 'function\tnative ms\tjs ms\tjs helpers ms\tjs/native\thelper kind\n'
+	cat "$TMPDIR/report"
+} > "${OUTFILE}"
+cat "$TMPDIR/summary"
+echo "Per-function report: $OUTFILE"
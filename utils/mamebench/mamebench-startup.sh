@@ -0,0 +1,119 @@
+#!/bin/bash
+#
+# Measures how long a game takes to get to its first frame.
+#
+# Phases are cumulative and each comes from its own invocation:
+#   init  - driver lookup and device construction (-listdevices)
+#   rom   - ROM load and verify on top of init (-verifyroms)
+#   boot  - device start and first frame on top of rom, extrapolated from
+#           -str 1 and -str 3 runs so the emulated seconds drop out
+#   total - time to first frame
+#
+# Cold runs evict the ROM set and the executable from the page cache first
+# (needs `vmtouch`, or write access to /proc/sys/vm/drop_caches).
+#
+
+ROMDIR=$1
+LOGFILE=$2
+GAME=$3
+
+REPEATS=5
+EXECUTABLE=mame
+SOFTWARE=
+
+shift 3
+while getopts "r:x:w:" opt; do
+	case "$opt" in
+	r)
+		REPEATS=$OPTARG
+		;;
+	x)
+		EXECUTABLE=$OPTARG
+		;;
+	w)
+		SOFTWARE=$OPTARG
+		;;
+	esac
+done
+
+TMPDIR=$(mktemp -d)
+trap 'rm -rf "$TMPDIR"' EXIT
+
+# Prints the wall time of a command in milliseconds.
+elapsed() {
+	START=$(date +%s%N)
+	SDLMAME_DESKTOPDIM=800x600 SDL_VIDEODRIVER=dummy SDL_RENDER_DRIVER=software "$@" >/dev/null 2>&1
+	END=$(date +%s%N)
+	echo $(( (END - START) / 1000000 ))
+}
+
+evict() {
+	EXEPATH=$(command -v "${EXECUTABLE}")
+	if hash vmtouch 2>/dev/null; then
+		vmtouch -eq "$EXEPATH" "$ROMDIR"/$GAME.* 2>/dev/null
+	elif [ -w /proc/sys/vm/drop_caches ]; then
+		sync
+		echo 1 > /proc/sys/vm/drop_caches
+	else
+		return 1
+	fi
+}
+
+# Runs every phase once and appends the results to $TMPDIR/<mode>.<phase>.
+measure() {
+	MODE=$1
+	INIT=$(elapsed "${EXECUTABLE}" -listdevices $GAME)
+	[ "$MODE" = "cold" ] && evict
+	VERIFY=$(elapsed "${EXECUTABLE}" -rompath "$ROMDIR" -verifyroms $GAME)
+	[ "$MODE" = "cold" ] && evict
+	RUN1=$(elapsed "${EXECUTABLE}" -rompath "$ROMDIR" -str 1 -nothrottle -video none -sound none $GAME $SOFTWARE)
+	[ "$MODE" = "cold" ] && evict
+	RUN3=$(elapsed "${EXECUTABLE}" -rompath "$ROMDIR" -str 3 -nothrottle -video none -sound none $GAME $SOFTWARE)
+
+	TOTAL=$(( RUN1 - (RUN3 - RUN1) / 2 ))
+	[ $TOTAL -lt $VERIFY ] && TOTAL=$VERIFY
+	ROM=$(( VERIFY - INIT ))
+	[ $ROM -lt 0 ] && ROM=0
+
+	echo $INIT >> "$TMPDIR/$MODE.init"
+	echo $ROM >> "$TMPDIR/$MODE.rom"
+	echo $(( TOTAL - VERIFY )) >> "$TMPDIR/$MODE.boot"
+	echo $TOTAL >> "$TMPDIR/$MODE.total"
+}
+
+MODES="warm"
+if evict; then
+	MODES="cold warm"
+else
+	echo "Cannot evict the page cache, only measuring warm startup of $GAME" >&2
+fi
+
+# Warm up once so the first warm sample isn't secretly cold.
+elapsed "${EXECUTABLE}" -rompath "$ROMDIR" -verifyroms $GAME >/dev/null
+
+for I in $(seq $REPEATS); do
+	for MODE in $MODES; do
+		[ "$MODE" = "cold" ] && evict
+		measure $MODE
+	done
+done
+
+FULLNAME=$("${EXECUTABLE}" -listfull $GAME |tail -1 |sed -r 's/^.*"(.*)"$/\1/g')
+if [ "$SOFTWARE" != "" ]; then
+	FULLNAME="$FULLNAME / $SOFTWARE"
+	GAME="$GAME:$SOFTWARE"
+fi
+
+# <game> <fullname> <milliseconds> startup.<mode>.<phase>.<percentile>
+for MODE in $MODES; do
+	for PHASE in init rom boot total; do
+		sort -n "$TMPDIR/$MODE.$PHASE" | awk -v game="$GAME" -v fullname="$FULLNAME" -v metric="startup.$MODE.$PHASE" '
+		{ v[NR] = $1 }
+		function pct(p,   i) { i = int(p * NR + 0.999999); if (i < 1) i = 1; return v[i] }
+		END {
+			printf "%s\t%s\t%d\t%s.p50\n", game, fullname, pct(0.5), metric
+			printf "%s\t%s\t%d\t%s.p90\n", game, fullname, pct(0.9), metric
+			printf "%s\t%s\t%d\t%s.max\n", game, fullname, v[NR], metric
+		}' >> "${LOGFILE}"
+	done
+done
@@ -1,7 +1,7 @@
 #!/bin/sh
 
 if [ $# -lt 2 ]; then 
-	echo "Usage: $0 <romdir> <logfile> [-t <benchtime>] [-j <processes>] [-x <executable>]"
+	echo "Usage: $0 <romdir> <logfile> [-t <benchtime>] [-j <processes>] [-p <pattern>] [-x <executable>] [-d <dbfile>] [-s [-r <repeats>]] [-c] [-l [-n <count>] [-k <seed>] [-b]] [-v <SDL video driver>]"
 	exit 1
 fi
 
@@ -11,9 +11,15 @@ BENCHTIME=30
 PROCESSES=4
 PATTERN="*"
 EXECUTABLE=mame
+DBFILE=
+STARTUP=
+REPEATS=5
+CALIBRATE=
+SOFTLIST=
+SPLIT=
 
 shift 2
-while getopts "t:j:p:x:" opt; do
+while getopts "t:j:p:x:d:sr:cln:k:bv:" opt; do
 	case "$opt" in
 	t)
 		BENCHTIME=$OPTARG
@@ -27,6 +33,33 @@ while getopts "t:j:p:x:" opt; do
 	x)
 		EXECUTABLE=$OPTARG
 		;;
+	d)
+		DBFILE=$OPTARG
+		;;
+	s)
+		STARTUP=-s
+		;;
+	r)
+		REPEATS=$OPTARG
+		;;
+	c)
+		CALIBRATE=1
+		;;
+	l)
+		SOFTLIST="$SOFTLIST -l"
+		;;
+	n)
+		SOFTLIST="$SOFTLIST -n $OPTARG"
+		;;
+	k)
+		SOFTLIST="$SOFTLIST -k $OPTARG"
+		;;
+	b)
+		SOFTLIST="$SOFTLIST -b"
+		;;
+	v)
+		SPLIT="-v $OPTARG"
+		;;
 	esac
 done
 
@@ -37,6 +70,37 @@ fi
 
 NUMROMS=$(ls "${ROMDIR}"/${PATTERN} |wc -l)
 
-echo "Benchmarking $NUMROMS roms in $ROMDIR for $BENCHTIME seconds ($PROCESSES processes)"
+# Cold startup runs evict the page cache (see mamebench-startup.sh), which
+# would also slow down the startups other jobs are timing.
+if [ "$STARTUP" != "" ] && [ "$PROCESSES" -gt 1 ] && { hash vmtouch 2>/dev/null || [ -w /proc/sys/vm/drop_caches ]; }; then
+	echo "Cold startup runs evict the page cache, running one job at a time"
+	PROCESSES=1
+fi
+
+if [ "$STARTUP" != "" ]; then
+	echo "Benchmarking startup of $NUMROMS roms in $ROMDIR, $REPEATS repeats ($PROCESSES processes)"
+else
+	echo "Benchmarking $NUMROMS roms in $ROMDIR for $BENCHTIME seconds ($PROCESSES processes)"
+fi
+
+# The reference score is taken once before any job runs, with as many
+# kernels running at once as there will be jobs, so it reflects the clock
+# the jobs get under that load (all-core rather than single-core turbo).
+if [ "$CALIBRATE" != "" ]; then
+	REFSCORE=$(./mamebench-calibrate.sh -j $PROCESSES | cut -f 1)
+	echo "Calibration reference score: $REFSCORE"
+	CALIBRATE="-c $REFSCORE"
+fi
+
+./mamebench-buildqueue.sh "$ROMDIR" "$LOGFILE" -t $BENCHTIME -p "$PATTERN" -x "$EXECUTABLE" $STARTUP -r $REPEATS $CALIBRATE $SOFTLIST $SPLIT | ./procspawn.sh $PROCESSES
 
-./mamebench-buildqueue.sh "$ROMDIR" "$LOGFILE" -t $BENCHTIME -p "$PATTERN" -x "$EXECUTABLE" | ./procspawn.sh $PROCESSES
+if [ "$DBFILE" != "" ]; then
+	if [ "$STARTUP" != "" ]; then
+		RUNFLAGS="-s -r $REPEATS"
+	elif [ "$SPLIT" != "" ]; then
+		RUNFLAGS="-bench $BENCHTIME $SPLIT"
+	else
+		RUNFLAGS="-bench $BENCHTIME"
+	fi
+	./mamebench-db.sh "$DBFILE" ingest "$LOGFILE" -x "$EXECUTABLE" -f "$RUNFLAGS"
+fi